@@ -0,0 +1,173 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Microbenchmark for picking a coding set.
+ *
+ * Gives every neighbor a queue head that each other neighbor has overheard
+ * with the given probability, then greedily grows coding sets from random
+ * next hops: once by scanning every neighbor against IPCopePacketInfo as
+ * Encode used to, and once through IPCopeCodingIndex. Both pick neighbors
+ * in id order, so they must agree on every set.
+ *
+ *   ./waf --run "IPCope-coding-bench --overhear=0.7 --iterations=200000"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/IPCope-packet-info.h"
+#include "ns3/IPCope-coding-index.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+using namespace ns3;
+using namespace ns3::ipcope;
+
+static NeighborBitmap
+ScanCodingSet (const IPCopePacketInfo &info, const std::vector<uint32_t> &heads, uint32_t nexthop)
+{
+  NeighborBitmap nexthops;
+  nexthops.Set (nexthop);
+  NeighborBitmap nativesHolders = info.Holders (heads[nexthop]);
+  for (uint32_t id = 0; id < heads.size (); id++)
+    {
+      if (nexthops.Test (id))
+        {
+          continue;
+        }
+      NeighborBitmap holders = info.Holders (heads[id]);
+      if (holders.Test (id) || !holders.Contains (nexthops) || !nativesHolders.Test (id))
+        {
+          continue;
+        }
+      nexthops.Set (id);
+      nativesHolders &= holders;
+    }
+  return nexthops;
+}
+
+static NeighborBitmap
+IndexCodingSet (const IPCopePacketInfo &info, const IPCopeCodingIndex &index,
+                const std::vector<uint32_t> &heads, uint32_t nexthop)
+{
+  NeighborBitmap nexthops;
+  nexthops.Set (nexthop);
+  NeighborBitmap nativesHolders = info.Holders (heads[nexthop]);
+  NeighborBitmap candidates = index.Pending ();
+  candidates &= index.Knows (nexthop);
+  candidates &= nativesHolders;
+  for (int32_t id = candidates.First (); id >= 0; id = candidates.First ())
+    {
+      candidates.Clear (id);
+      // the same checks Encode still makes on every candidate
+      NeighborBitmap holders = info.Holders (heads[id]);
+      if (nexthops.Test (id) || holders.Test (id) || !holders.Contains (nexthops) || !nativesHolders.Test (id))
+        {
+          continue;
+        }
+      nexthops.Set (id);
+      nativesHolders &= holders;
+      candidates &= index.Knows (id);
+      candidates &= nativesHolders;
+    }
+  return nexthops;
+}
+
+static uint32_t
+Count (NeighborBitmap bitmap)
+{
+  uint32_t count = 0;
+  for (int32_t id = bitmap.First (); id >= 0; id = bitmap.First ())
+    {
+      bitmap.Clear (id);
+      count++;
+    }
+  return count;
+}
+
+static void
+Report (const char *name, uint32_t neighbors, uint32_t iterations, int64_t ms, uint32_t members)
+{
+  if (ms <= 0)
+    {
+      ms = 1;
+    }
+  std::cout << std::setw (4) << neighbors << " neighbors " << std::setw (6) << name << ": "
+            << std::fixed << std::setprecision (1) << ms * 1e6 / iterations << " ns/set, "
+            << std::setprecision (2) << (double)members / iterations << " natives/set" << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t iterations = 200000;
+  double overhear = 0.7;
+
+  CommandLine cmd;
+  cmd.AddValue ("iterations", "Coding sets built per measurement", iterations);
+  cmd.AddValue ("overhear", "Probability that a neighbor holds another neighbor's head", overhear);
+  cmd.Parse (argc, argv);
+
+  uint32_t sizes[] = { 32, 64, 128 };
+  for (uint32_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); s++)
+    {
+      uint32_t neighbors = sizes[s];
+      IPCopePacketInfo info;
+      IPCopeCodingIndex index;
+      std::vector<uint32_t> heads (neighbors);
+      for (uint32_t id = 0; id < neighbors; id++)
+        {
+          uint8_t mac[6] = { 0, 0, 0, 0, (uint8_t)(id >> 8), (uint8_t)id };
+          Mac48Address address;
+          address.CopyFrom (mac);
+          info.NeighborId (address); // ids are handed out in order
+        }
+      for (uint32_t id = 0; id < neighbors; id++)
+        {
+          heads[id] = 1000 + id;
+          for (uint32_t other = 0; other < neighbors; other++)
+            {
+              if (other != id && std::rand () < overhear * RAND_MAX)
+                {
+                  info.SetItem (heads[id], info.NeighborMac (other));
+                }
+            }
+          index.SetHead (id, heads[id], info.Holders (heads[id]));
+        }
+
+      std::vector<uint32_t> nexthops (iterations);
+      for (uint32_t i = 0; i < iterations; i++)
+        {
+          nexthops[i] = std::rand () % neighbors;
+        }
+
+      SystemWallClockMs clock;
+      uint32_t members = 0;
+      clock.Start ();
+      for (uint32_t i = 0; i < iterations; i++)
+        {
+          members += Count (ScanCodingSet (info, heads, nexthops[i]));
+        }
+      Report ("scan", neighbors, iterations, clock.End (), members);
+
+      members = 0;
+      clock.Start ();
+      for (uint32_t i = 0; i < iterations; i++)
+        {
+          members += Count (IndexCodingSet (info, index, heads, nexthops[i]));
+        }
+      Report ("index", neighbors, iterations, clock.End (), members);
+
+      for (uint32_t i = 0; i < neighbors; i++)
+        {
+          NeighborBitmap scan = ScanCodingSet (info, heads, i);
+          NeighborBitmap indexed = IndexCodingSet (info, index, heads, i);
+          if (!scan.Contains (indexed) || !indexed.Contains (scan))
+            {
+              std::cout << "coding sets differ for next hop " << i << std::endl;
+              return 1;
+            }
+        }
+    }
+  return 0;
+}
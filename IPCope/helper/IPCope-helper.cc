@@ -24,18 +24,37 @@
 NS_LOG_COMPONENT_DEFINE ("IPCopeHelper");
 
 namespace ns3{
-IPCopeHelper::IPCopeHelper(){}
+IPCopeHelper::IPCopeHelper()
+{
+	m_factory.SetTypeId("ns3::ipcope::IPCopeProtocol");
+}
 IPCopeHelper::~IPCopeHelper(){}
 
+void
+IPCopeHelper::Set(std::string name, const AttributeValue & value)
+{
+	m_factory.Set(name, value);
+}
+
 NetDeviceContainer
 IPCopeHelper::InstallProtocol(NodeContainer nodes, bool mr, double rttime, double retry, double hello) 
 //IPCopeHelper::InstallProtocol(NodeContainer nodes, bool mr, double rttime, double hello) 
+{
+	//mr was never used by the protocol
+	m_factory.Set("RetransmitTimeout", TimeValue(MilliSeconds(rttime)));
+	m_factory.Set("TrySendInterval", TimeValue(MilliSeconds(retry)));
+	m_factory.Set("HelloInterval", TimeValue(Seconds(hello)));
+	return InstallProtocol(nodes);
+}
+
+NetDeviceContainer
+IPCopeHelper::InstallProtocol(NodeContainer nodes)
 {
 	NetDeviceContainer devices;
 	for(NodeContainer::Iterator iter = nodes.Begin(); iter!= nodes.End(); iter++)
 	{
 		Ptr<Node> node = *iter;
-		Ptr<ipcope::IPCopeProtocol> protocol = CreateObject<ipcope::IPCopeProtocol>(mr, rttime, retry, hello);
+		Ptr<ipcope::IPCopeProtocol> protocol = m_factory.Create<ipcope::IPCopeProtocol>();
 		protocol->SetNode(node);
 		node->AggregateObject(protocol);
 		uint32_t ifNum = node->GetNDevices();
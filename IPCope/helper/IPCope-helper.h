@@ -25,6 +25,7 @@
 #include "ns3/node-container.h"
 #include "ns3/IPCope-device.h"
 #include "ns3/IPCope-protocol.h"
+#include "ns3/object-factory.h"
 #include <vector>
 
 namespace ns3{
@@ -34,11 +35,16 @@ class IPCopeHelper
 public:
 	IPCopeHelper();
 	~IPCopeHelper();
+	//an attribute of every IPCopeProtocol installed afterwards
+	void Set(std::string name, const AttributeValue & value);
+	NetDeviceContainer InstallProtocol(NodeContainer nodes);
+	//sets RetransmitTimeout and TrySendInterval (ms) and HelloInterval (s) first
 	NetDeviceContainer InstallProtocol(NodeContainer nodes, bool mr, double rttime, double retry, double hello) ;
 	//NetDeviceContainer InstallProtocol(NodeContainer nodes, bool mr, double rttime, double hello) ;
 	void StartProtocol();
 
 private:
+	ObjectFactory m_factory;
 	std::vector<Ptr<ipcope::IPCopeProtocol> > m_protocols;
 };
 
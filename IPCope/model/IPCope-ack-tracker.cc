@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+#include "IPCope-ack-tracker.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE("IPCopeAckTracker");
+
+namespace ns3{
+namespace ipcope{
+
+IPCopeAckTracker::OutLink::OutLink() : next(0), hasRtt(false), srtt(0), rttvar(0)
+{
+	for(uint32_t i = 0; i<IPCOPE_ACK_WINDOW; i++)
+		slots[i].used = false;
+}
+
+IPCopeAckTracker::IPCopeAckTracker()
+{
+	m_initialRto = MilliSeconds(25);
+	m_minRto = MilliSeconds(5);
+	m_maxRto = Seconds(1);
+}
+
+IPCopeAckTracker::~IPCopeAckTracker(){}
+
+uint16_t
+IPCopeAckTracker::Assign(const Mac48Address & nexthop, uint32_t packetId)
+{
+	OutLink & link = m_out[nexthop];
+	uint16_t seq = link.next++;
+	//overwrites whatever went out a window ago, acked or not
+	SentSlot & slot = link.slots[seq % IPCOPE_ACK_WINDOW];
+	slot.seq = seq;
+	slot.pid = packetId;
+	slot.used = true;
+	NS_LOG_FUNCTION(this<<nexthop<<packetId<<seq);
+	return seq;
+}
+
+/*
+ * The nexthop keeps acking the numbers it got from us, so a new link for
+ * it would start over at a number it takes for an old one. If two known
+ * nexthops turn out to be one, the link under to is kept.
+ */
+void
+IPCopeAckTracker::Rekey(const Mac48Address & from, const Mac48Address & to)
+{
+	NS_LOG_FUNCTION(this<<from<<to);
+	std::tr1::unordered_map<Mac48Address, OutLink, Mac48AddressHash>::iterator iter = m_out.find(from);
+	if(iter == m_out.end() || from == to)
+		return;
+	if(m_out.find(to) == m_out.end())
+		m_out.insert(std::make_pair(to, iter->second));
+	m_out.erase(iter);
+}
+
+std::vector<Mac48Address>
+IPCopeAckTracker::GetNexthops() const
+{
+	std::vector<Mac48Address> nexthops;
+	std::tr1::unordered_map<Mac48Address, OutLink, Mac48AddressHash>::const_iterator iter;
+	for(iter = m_out.begin(); iter != m_out.end(); iter++)
+		nexthops.push_back(iter->first);
+	return nexthops;
+}
+
+std::vector<uint32_t>
+IPCopeAckTracker::Acked(const Mac48Address & nexthop, const AckBlock & ack)
+{
+	std::vector<uint32_t> pids;
+	std::tr1::unordered_map<Mac48Address, OutLink, Mac48AddressHash>::iterator iter = m_out.find(nexthop);
+	if(iter == m_out.end())
+		return pids;
+	std::vector<uint16_t> seqs = IPCopeHeader::Expand(ack);
+	for(uint32_t i = 0; i<seqs.size(); i++)
+	{
+		SentSlot & slot = iter->second.slots[seqs[i] % IPCOPE_ACK_WINDOW];
+		if(slot.used && slot.seq == seqs[i])
+		{
+			pids.push_back(slot.pid);
+			slot.used = false;
+		}
+	}
+	NS_LOG_FUNCTION(this<<nexthop<<ack.lastAck<<pids.size());
+	return pids;
+}
+
+void
+IPCopeAckTracker::RttSample(const Mac48Address & nexthop, Time rtt)
+{
+	NS_LOG_FUNCTION(this<<nexthop<<rtt.GetSeconds());
+	OutLink & link = m_out[nexthop];
+	double sample = rtt.GetSeconds();
+	if(!link.hasRtt)
+	{
+		link.srtt = sample;
+		link.rttvar = sample / 2;
+		link.hasRtt = true;
+		return;
+	}
+	double error = link.srtt > sample ? link.srtt - sample : sample - link.srtt;
+	link.rttvar = 0.75 * link.rttvar + 0.25 * error;
+	link.srtt = 0.875 * link.srtt + 0.125 * sample;
+}
+
+Time
+IPCopeAckTracker::GetRto(const Mac48Address & nexthop) const
+{
+	std::tr1::unordered_map<Mac48Address, OutLink, Mac48AddressHash>::const_iterator iter = m_out.find(nexthop);
+	if(iter == m_out.end() || !iter->second.hasRtt)
+		return m_initialRto;
+	Time rto = Seconds(iter->second.srtt + 4 * iter->second.rttvar);
+	if(rto < m_minRto)
+		return m_minRto;
+	if(rto > m_maxRto)
+		return m_maxRto;
+	return rto;
+}
+
+void
+IPCopeAckTracker::SetInitialRto(Time rto)
+{
+	m_initialRto = rto;
+}
+
+Time
+IPCopeAckTracker::GetInitialRto() const
+{
+	return m_initialRto;
+}
+
+void
+IPCopeAckTracker::SetMinRto(Time rto)
+{
+	m_minRto = rto;
+}
+
+Time
+IPCopeAckTracker::GetMinRto() const
+{
+	return m_minRto;
+}
+
+void
+IPCopeAckTracker::SetMaxRto(Time rto)
+{
+	m_maxRto = rto;
+}
+
+Time
+IPCopeAckTracker::GetMaxRto() const
+{
+	return m_maxRto;
+}
+
+void
+IPCopeAckTracker::Received(const Ipv4Address & sender, uint16_t seq)
+{
+	NS_LOG_FUNCTION(this<<sender<<seq);
+	std::map<Ipv4Address, InLink>::iterator iter = m_in.find(sender);
+	if(iter == m_in.end())
+	{
+		InLink link;
+		link.ack.address = sender;
+		link.ack.lastAck = seq;
+		link.ack.ackMap = 0;
+		link.pending = false;
+		iter = m_in.insert(std::make_pair(sender, link)).first;
+	}
+	else
+	{
+		AckBlock & ack = iter->second.ack;
+		int16_t distance = (int16_t)(seq - ack.lastAck);
+		if(distance > 0)
+		{
+			//slide the window forward; lastAck becomes one of the bits
+			if(distance > 32)
+				ack.ackMap = 0;
+			else
+				ack.ackMap = (uint32_t)((((uint64_t)ack.ackMap << 1) | 1) << (distance - 1));
+			ack.lastAck = seq;
+		}
+		else if(distance < 0 && distance >= -32)
+			ack.ackMap |= 1u << (-distance - 1);
+	}
+	//duplicates are acked again, the ack for them may have been lost
+	if(!iter->second.pending)
+	{
+		iter->second.pending = true;
+		m_pending.push_back(sender);
+	}
+}
+
+std::vector<AckBlock>
+IPCopeAckTracker::TakePending(uint32_t max)
+{
+	std::vector<AckBlock> acks;
+	while(m_pending.size() && acks.size() < max)
+	{
+		InLink & link = m_in[m_pending.front()];
+		m_pending.pop_front();
+		link.pending = false;
+		acks.push_back(link.ack);
+	}
+	return acks;
+}
+
+}//namespace ipcope
+}//namespace ns3
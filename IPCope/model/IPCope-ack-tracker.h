@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+#ifndef COPEACKTRACKER_H
+#define COPEACKTRACKER_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/mac48-address.h"
+#include "ns3/nstime.h"
+#include "IPCope-header.h"
+#include "IPCope-neighbor.h"
+#include <deque>
+#include <map>
+#include <vector>
+#include <tr1/unordered_map>
+
+namespace ns3{
+namespace ipcope{
+
+#define IPCOPE_ACK_WINDOW 64 //sequence numbers remembered per link, more than an ack block covers
+
+/*
+ * Per-link sequence numbers for coded natives, and the acks for them. The
+ * sender numbers what it sends each nexthop separately; the nexthop acks
+ * with the newest number it got from that sender and a bitmap of the 32
+ * before it, so one block per neighbor covers every recent native no
+ * matter how many acks were lost. The sender also times the acks to get a
+ * retransmit timeout per nexthop, as TCP does (RFC 6298).
+ */
+class IPCopeAckTracker
+{
+public:
+	IPCopeAckTracker();
+	~IPCopeAckTracker();
+
+	//sender side, keyed by the nexthop's primary mac
+	uint16_t Assign(const Mac48Address & nexthop, uint32_t packetId);
+	//the nexthop's primary mac changed; its numbering goes on under the new one
+	void Rekey(const Mac48Address & from, const Mac48Address & to);
+	std::vector<Mac48Address> GetNexthops() const;
+	//pids the block acks that weren't acked before
+	std::vector<uint32_t> Acked(const Mac48Address & nexthop, const AckBlock & ack);
+	//only natives sent once make samples, a retransmitted one's ack is ambiguous
+	void RttSample(const Mac48Address & nexthop, Time rtt);
+	Time GetRto(const Mac48Address & nexthop) const; //the initial one until there is a sample
+	void SetInitialRto(Time rto);
+	Time GetInitialRto() const;
+	void SetMinRto(Time rto);
+	Time GetMinRto() const;
+	void SetMaxRto(Time rto);
+	Time GetMaxRto() const;
+
+	//receiver side, keyed by the ip the sender puts in IPCopeHeader
+	void Received(const Ipv4Address & sender, uint16_t seq);
+	//blocks for senders we got something new from, at most max, oldest first
+	std::vector<AckBlock> TakePending(uint32_t max);
+	uint32_t PendingSize() const { return m_pending.size(); }
+private:
+	struct SentSlot
+	{
+		uint16_t seq;
+		uint32_t pid;
+		bool used;
+	};
+	struct OutLink
+	{
+		uint16_t next;
+		SentSlot slots[IPCOPE_ACK_WINDOW]; //by seq modulo the window
+		bool hasRtt;
+		double srtt; //seconds
+		double rttvar;
+		OutLink();
+	};
+	struct InLink
+	{
+		AckBlock ack;
+		bool pending;
+	};
+	std::tr1::unordered_map<Mac48Address, OutLink, Mac48AddressHash> m_out;
+	std::map<Ipv4Address, InLink> m_in;
+	std::deque<Ipv4Address> m_pending;
+	Time m_initialRto;
+	Time m_minRto;
+	Time m_maxRto;
+};
+
+}//namespace ipcope
+}//namespace ns3
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#include "IPCope-coding-index.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE("IPCopeCodingIndex");
+
+namespace ns3{
+namespace ipcope{
+
+IPCopeCodingIndex::IPCopeCodingIndex():
+	m_heads(IPCOPE_MAX_NEIGHBORS),
+	m_knows(IPCOPE_MAX_NEIGHBORS)
+{}
+
+IPCopeCodingIndex::~IPCopeCodingIndex(){}
+
+void
+IPCopeCodingIndex::SetHead(uint32_t id, uint32_t packetId, const NeighborBitmap & holders)
+{
+	NS_LOG_FUNCTION(this<<id<<packetId);
+	NS_ASSERT(id < IPCOPE_MAX_NEIGHBORS);
+	ClearHead(id);
+	HeadSlot & slot = m_heads[id];
+	slot.pid = packetId;
+	slot.holders = holders;
+	NeighborBitmap rest = holders;
+	for(int32_t n = rest.First(); n >= 0; n = rest.First())
+	{
+		m_knows[n].Set(id);
+		rest.Clear(n);
+	}
+	m_owners[packetId] = id;
+	m_pending.Set(id);
+}
+
+void
+IPCopeCodingIndex::ClearHead(uint32_t id)
+{
+	NS_ASSERT(id < IPCOPE_MAX_NEIGHBORS);
+	m_dirty.Clear(id);
+	if(!m_pending.Test(id))
+		return;
+	HeadSlot & slot = m_heads[id];
+	for(int32_t n = slot.holders.First(); n >= 0; n = slot.holders.First())
+	{
+		m_knows[n].Clear(id);
+		slot.holders.Clear(n);
+	}
+	std::tr1::unordered_map<uint32_t, uint32_t>::iterator iter = m_owners.find(slot.pid);
+	if(iter != m_owners.end() && iter->second == id)
+		m_owners.erase(iter);
+	m_pending.Clear(id);
+}
+
+uint32_t
+IPCopeCodingIndex::GetHead(uint32_t id) const
+{
+	NS_ASSERT(HasHead(id));
+	return m_heads[id].pid;
+}
+
+void
+IPCopeCodingIndex::AddHolder(uint32_t packetId, uint32_t id)
+{
+	std::tr1::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_owners.find(packetId);
+	if(iter == m_owners.end())
+		return;
+	NS_LOG_LOGIC("neighbor "<<id<<" has the head of "<<iter->second);
+	m_heads[iter->second].holders.Set(id);
+	m_knows[id].Set(iter->second);
+}
+
+void
+IPCopeCodingIndex::Forget(uint32_t id)
+{
+	NS_LOG_FUNCTION(this<<id);
+	ClearHead(id);
+	NeighborBitmap heads = m_knows[id];
+	for(int32_t n = heads.First(); n >= 0; n = heads.First())
+	{
+		m_heads[n].holders.Clear(id);
+		heads.Clear(n);
+	}
+	m_knows[id] = NeighborBitmap();
+}
+
+const NeighborBitmap &
+IPCopeCodingIndex::Knows(uint32_t id) const
+{
+	NS_ASSERT(id < IPCOPE_MAX_NEIGHBORS);
+	return m_knows[id];
+}
+
+}//namespace ipcope
+}//namespace ns3
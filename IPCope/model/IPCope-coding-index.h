@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#ifndef COPECODINGINDEX_H
+#define COPECODINGINDEX_H
+
+#include "IPCope-packet-info.h"
+#include <vector>
+#include <tr1/unordered_map>
+
+namespace ns3{
+namespace ipcope{
+
+/*
+ * Who-has-what for the heads of the virtual queues, kept up to date as
+ * reception reports and acks come in. Knows(n) is the set of neighbors
+ * whose head neighbor n already holds, so the neighbors that can join a
+ * coding set are the AND of Knows() over the next hops picked so far and
+ * picking a set costs a few bitmap operations per member.
+ *
+ * The index is a filter: the protocol still checks every neighbor it picks
+ * against IPCopePacketInfo. Heads go stale when the queues change, so
+ * whoever changes a virtual queue calls Invalidate() and refreshes the
+ * dirty neighbors with SetHead()/ClearHead() before the next lookup.
+ */
+class IPCopeCodingIndex
+{
+public:
+	IPCopeCodingIndex();
+	~IPCopeCodingIndex();
+
+	void SetHead(uint32_t id, uint32_t packetId, const NeighborBitmap & holders);
+	void ClearHead(uint32_t id);
+	bool HasHead(uint32_t id) const { return m_pending.Test(id); }
+	uint32_t GetHead(uint32_t id) const;
+	void AddHolder(uint32_t packetId, uint32_t id);
+	void Forget(uint32_t id); //id was released: drops its head and it as a holder
+
+	void Invalidate(uint32_t id) { m_dirty.Set(id); }
+	void InvalidateAll() { m_dirty = NeighborBitmap::All(); }
+	const NeighborBitmap & Dirty() const { return m_dirty; }
+
+	//neighbors with a head
+	const NeighborBitmap & Pending() const { return m_pending; }
+	const NeighborBitmap & Knows(uint32_t id) const;
+private:
+	struct HeadSlot
+	{
+		uint32_t pid;
+		NeighborBitmap holders;
+		HeadSlot() : pid(0) {}
+	};
+	std::vector<HeadSlot> m_heads; //indexed by neighbor id
+	std::vector<NeighborBitmap> m_knows; //indexed by neighbor id
+	NeighborBitmap m_pending;
+	NeighborBitmap m_dirty;
+	//head pid -> neighbor id; a pid heading two virtual queues is only tracked for the later one
+	std::tr1::unordered_map<uint32_t, uint32_t> m_owners;
+};
+
+}//namespace ipcope
+}//namespace ns3
+
+#endif
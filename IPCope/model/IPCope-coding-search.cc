@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#include "IPCope-coding-search.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <iterator>
+
+NS_LOG_COMPONENT_DEFINE("IPCopeCodingSearch");
+
+namespace ns3{
+namespace ipcope{
+
+IPCopeCodingSearch::IPCopeCodingSearch(const IPCopePacketInfo & packetInfo, const IPCopeLinkEstimator & linkEstimator):
+	m_packetInfo(packetInfo),
+	m_linkEstimator(linkEstimator),
+	m_maxPaddingRatio(1.0),
+	m_codingThreshold(1.0)
+{}
+
+IPCopeCodingSearch::~IPCopeCodingSearch(){}
+
+void
+IPCopeCodingSearch::SetMaxPaddingRatio(double ratio)
+{
+	m_maxPaddingRatio = ratio;
+}
+
+void
+IPCopeCodingSearch::SetCodingThreshold(double threshold)
+{
+	m_codingThreshold = threshold;
+}
+
+void
+IPCopeCodingSearch::SetFreeChannels(const std::set<uint16_t> & channels)
+{
+	m_freeChannels = channels;
+}
+
+/*
+ * Length classes double from 64 bytes up, so TCP acks and full-sized
+ * segments land several classes apart.
+ */
+uint32_t
+IPCopeCodingSearch::LengthClass(uint32_t length)
+{
+	uint32_t lengthClass = 0;
+	for(length >>= 6; length && lengthClass < IPCOPE_LENGTH_CLASSES - 1; length >>= 1)
+		lengthClass++;
+	return lengthClass;
+}
+
+void
+IPCopeCodingSearch::Search(const std::vector<IPCopeCodingOption> & options, const IPCopeCodingSet & set,
+		std::vector<uint32_t> & best, uint32_t & budget) const
+{
+	std::vector<uint32_t> chosen;
+	uint32_t bestPadding = 0;
+	best.clear();
+	Search(options, 0, set, chosen, best, bestPadding, budget);
+}
+
+/*
+ * Depth-first over options[start..], extending set. At every level the
+ * first branch is the first option that fits, so the greedy set is found
+ * before anything else.
+ */
+void
+IPCopeCodingSearch::Search(const std::vector<IPCopeCodingOption> & options, uint32_t start, const IPCopeCodingSet & set,
+		std::vector<uint32_t> & chosen, std::vector<uint32_t> & best, uint32_t & bestPadding, uint32_t & budget) const
+{
+	//zero bytes sent to make every native as long as the longest; never shrinks as the set grows
+	uint32_t padding = (chosen.size() + 1) * set.maxLength - set.bytes;
+	if(chosen.size() > best.size() || (chosen.size() && chosen.size() == best.size() && padding < bestPadding))
+	{
+		best = chosen;
+		bestPadding = padding;
+	}
+	for(uint32_t i = start; i < options.size() && budget; i++)
+	{
+		//taking every option left still wouldn't beat the best set
+		uint32_t most = chosen.size() + options.size() - i;
+		if(most < best.size() || (most == best.size() && padding >= bestPadding))
+			return;
+		budget--;
+		const IPCopeCodingOption & option = options[i];
+		//one native per nexthop, every nexthop must have it, and the new nexthop every native
+		if(set.nexthops.Test(option.id))
+			continue;
+		IPCopeCodingSet next;
+		if(!set.members.empty())
+		{
+			if(!Decodable(set, option, next.decode))
+				continue;
+			next.members = set.members;
+			next.members.push_back(&option);
+		}
+		else if(!option.holders.Contains(set.nexthops) || !set.holders.Test(option.id))
+			continue;
+		uint32_t minLength = std::min(set.minLength, option.length);
+		uint32_t maxLength = std::max(set.maxLength, option.length);
+		if(maxLength - minLength > m_maxPaddingRatio * maxLength)
+		{
+			NS_LOG_LOGIC("Can't encode, "<<minLength<<" bytes padded to "<<maxLength);
+			continue;
+		}
+		if(!Channels(set.channels, option, next.channels))
+		{
+			NS_LOG_LOGIC("Can't encode due to channel");
+			continue;
+		}
+		next.nexthops = set.nexthops;
+		next.nexthops.Set(option.id);
+		next.holders = set.holders;
+		next.holders &= option.holders;
+		next.minLength = minLength;
+		next.maxLength = maxLength;
+		next.bytes = set.bytes + option.length;
+		chosen.push_back(i);
+		Search(options, i + 1, next, chosen, best, bestPadding, budget);
+		chosen.pop_back();
+	}
+}
+
+/*
+ * Whether every nexthop, option's included, could still decode with
+ * option's native added, each with at least the coding threshold as
+ * probability; decode gets those probabilities in the order of members.
+ */
+bool
+IPCopeCodingSearch::Decodable(const IPCopeCodingSet & set, const IPCopeCodingOption & option, std::vector<double> & decode) const
+{
+	double own = 1;
+	decode.clear();
+	for(uint32_t i = 0; i < set.members.size(); i++)
+	{
+		const IPCopeCodingOption & member = *set.members[i];
+		own *= DeliveryProbability(member, option.id);
+		decode.push_back(set.decode[i] * DeliveryProbability(option, member.id));
+		if(own < m_codingThreshold || decode.back() < m_codingThreshold)
+			return false;
+	}
+	decode.push_back(own);
+	return true;
+}
+
+/*
+ * How likely neighbor id has the native: certain if it said so, otherwise
+ * how well it hears from the neighbor we got the packet from.
+ */
+double
+IPCopeCodingSearch::DeliveryProbability(const IPCopeCodingOption & native, uint32_t id) const
+{
+	if(native.holders.Test(id))
+		return 1;
+	if(!native.hasPrevHop)
+		return 0;
+	return m_linkEstimator.GetDelivery(native.prevHop, m_packetInfo.NeighborMac(id));
+}
+
+bool
+IPCopeCodingSearch::Channels(const std::set<uint16_t> & channels, const IPCopeCodingOption & option, std::set<uint16_t> & intersection) const
+{
+	intersection.clear();
+	set_intersection(channels.begin(), channels.end(), option.channels.begin(), option.channels.end(), std::insert_iterator<std::set<uint16_t> > (intersection, intersection.begin()));
+	std::set<uint16_t>::const_iterator channel_iter;
+	for(channel_iter = intersection.begin(); channel_iter != intersection.end(); channel_iter++)
+	{
+		if(m_freeChannels.count(*channel_iter))
+			return true;
+	}
+	return false;
+}
+
+}//namespace ipcope
+}//namespace ns3
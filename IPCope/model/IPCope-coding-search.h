@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#ifndef COPECODINGSEARCH_H
+#define COPECODINGSEARCH_H
+
+#include "IPCope-packet-info.h"
+#include "IPCope-link-estimator.h"
+#include "IPCope-queue.h"
+#include "ns3/mac48-address.h"
+#include <set>
+#include <vector>
+
+namespace ns3{
+namespace ipcope{
+
+#define IPCOPE_LENGTH_CLASSES 8 //under 64 bytes, under 128, ... under 4096, longer
+
+//a native that may join a coding set
+struct IPCopeCodingOption
+{
+	int32_t neighborPos;
+	uint32_t id; //of the neighbor it is for
+	uint32_t depth; //how far back in the virtual queue
+	IPCopeQueueEntry* entry;
+	NeighborBitmap holders;
+	uint32_t length;
+	bool hasPrevHop;
+	Mac48Address prevHop;
+	std::set<uint16_t> channels; //the neighbor listens on
+};
+
+struct IPCopeCodingSet
+{
+	NeighborBitmap nexthops;
+	NeighborBitmap holders; //neighbors that have every native
+	std::set<uint16_t> channels; //channels every nexthop listens on
+	uint32_t minLength;
+	uint32_t maxLength;
+	uint32_t bytes; //total length of the natives
+	//only when guessing: the natives so far, and how likely each one's nexthop decodes
+	std::vector<const IPCopeCodingOption*> members;
+	std::vector<double> decode;
+};
+
+/*
+ * Picks which natives to XOR with the one at the head of the queue: the
+ * largest set of options that every nexthop can decode, that shares a
+ * channel with a free interface and that keeps zero padding within
+ * MaxPaddingRatio. Of two sets of the same size the one with less padding
+ * wins.
+ */
+class IPCopeCodingSearch
+{
+public:
+	IPCopeCodingSearch(const IPCopePacketInfo & packetInfo, const IPCopeLinkEstimator & linkEstimator);
+	~IPCopeCodingSearch();
+
+	void SetMaxPaddingRatio(double ratio);
+	//below one, natives a nexthop has probably overheard count too; set.members must then hold the first native
+	void SetCodingThreshold(double threshold);
+	void SetFreeChannels(const std::set<uint16_t> & channels); //those with an interface free to send on
+
+	//best gets indexes into options; budget caps how many options are examined and is left with what remains
+	void Search(const std::vector<IPCopeCodingOption> & options, const IPCopeCodingSet & set,
+			std::vector<uint32_t> & best, uint32_t & budget) const;
+	//channels shared with option's neighbor; true if one of them is free
+	bool Channels(const std::set<uint16_t> & channels, const IPCopeCodingOption & option, std::set<uint16_t> & intersection) const;
+
+	static uint32_t LengthClass(uint32_t length);
+private:
+	void Search(const std::vector<IPCopeCodingOption> & options, uint32_t start, const IPCopeCodingSet & set,
+			std::vector<uint32_t> & chosen, std::vector<uint32_t> & best, uint32_t & bestPadding, uint32_t & budget) const;
+	bool Decodable(const IPCopeCodingSet & set, const IPCopeCodingOption & option, std::vector<double> & decode) const;
+	double DeliveryProbability(const IPCopeCodingOption & native, uint32_t id) const;
+
+	const IPCopePacketInfo & m_packetInfo;
+	const IPCopeLinkEstimator & m_linkEstimator;
+	double m_maxPaddingRatio;
+	double m_codingThreshold;
+	std::set<uint16_t> m_freeChannels;
+};
+
+}//namespace ipcope
+}//namespace ns3
+
+#endif
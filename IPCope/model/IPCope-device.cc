@@ -64,6 +64,8 @@ IPCopeDevice::SetCopeProtocol(Ptr<IPCopeProtocol> cope)
 {
 	NS_LOG_FUNCTION_NOARGS();
 	m_cope = cope;
+	if(m_wifiNetDevice != 0)
+		ResolveMacQueue();
 }
 
 void
@@ -102,34 +104,58 @@ IPCopeDevice::GetChannel() const
 	return m_channel;
 }
 
-bool
-IPCopeDevice::IsQueueFull() const
+/*
+ * Looks the mac queue up through the DcaTxop attribute of the wifi device's
+ * mac, sizes it and hooks the transmit notifications onto that mac, after
+ * unhooking them from the mac resolved before, if any. Runs once both the
+ * interface and the protocol are set.
+ */
+void
+IPCopeDevice::ResolveMacQueue()
 {
-	Ptr<WifiNetDevice> wifiNetDevice = m_iface->GetObject<WifiNetDevice>();
-	Ptr<RegularWifiMac> wifiMac = wifiNetDevice->GetMac()->GetObject<RegularWifiMac>();
-	//Ptr<DcaTxop> txop = wifiMac->GetDcaTxop();
+	NS_LOG_FUNCTION_NOARGS();
+	if(m_wifiMac != 0)
+	{
+		m_wifiMac->TraceDisconnectWithoutContext("TxOkHeader", MakeCallback(&IPCopeDevice::NotifyTxDone, this));
+		m_wifiMac->TraceDisconnectWithoutContext("TxErrHeader", MakeCallback(&IPCopeDevice::NotifyTxDone, this));
+	}
+	m_wifiMac = m_wifiNetDevice->GetMac();
+	Ptr<RegularWifiMac> wifiMac = m_wifiMac->GetObject<RegularWifiMac>();
 	PointerValue ptr;
-	Ptr<DcaTxop> txop;
 	wifiMac->GetAttribute("DcaTxop", ptr);
-	txop = ptr.Get<DcaTxop>();
-	//return txop->IsQueueFull();
-	Ptr<WifiMacQueue> wifiMacQueue = txop->GetQueue();
-	//return wifiMacQueue->IsFull();
+	Ptr<DcaTxop> txop = ptr.Get<DcaTxop>();
+	m_macQueue = txop->GetQueue();
+	m_macQueue->SetMaxSize(m_cope->GetMacQueueDepth());
+	m_wifiMac->TraceConnectWithoutContext("TxOkHeader", MakeCallback(&IPCopeDevice::NotifyTxDone, this));
+	m_wifiMac->TraceConnectWithoutContext("TxErrHeader", MakeCallback(&IPCopeDevice::NotifyTxDone, this));
+}
+
+Ptr<WifiMacQueue>
+IPCopeDevice::GetMacQueue() const
+{
+	return m_macQueue;
+}
+
+bool
+IPCopeDevice::IsQueueFull() const
+{
+	Ptr<WifiMacQueue> wifiMacQueue = GetMacQueue();
 	return (wifiMacQueue->GetSize() == wifiMacQueue->GetMaxSize());
 }
 
 uint32_t
 IPCopeDevice::GetMacQueueSize() const
 {
-	Ptr<WifiNetDevice> wifiNetDevice = m_iface->GetObject<WifiNetDevice>();
-	Ptr<RegularWifiMac> wifiMac = wifiNetDevice->GetMac()->GetObject<RegularWifiMac>();
-	//Ptr<DcaTxop> txop = wifiMac->GetDcaTxop();
-	//return txop->GetQueueSize();
-	PointerValue ptr;
-	wifiMac->GetAttribute("DcaTxop", ptr);
-	Ptr<DcaTxop> txop = ptr.Get<DcaTxop>();
-	Ptr<WifiMacQueue> wifiMacQueue = txop->GetQueue();
-	return wifiMacQueue->GetSize();
+	return GetMacQueue()->GetSize();
+}
+
+uint32_t
+IPCopeDevice::GetFreeSlots() const
+{
+	Ptr<WifiMacQueue> wifiMacQueue = GetMacQueue();
+	uint32_t size = wifiMacQueue->GetSize();
+	uint32_t max = wifiMacQueue->GetMaxSize();
+	return size < max ? max - size : 0;
 }
 
 Address
@@ -322,17 +348,15 @@ IPCopeDevice::SetInterface (Ptr<NetDevice> iface)
 	if(wifiNetDevice == 0)
 		NS_FATAL_ERROR("Device is not a Wifi NIC");
 
-	Ptr<RegularWifiMac> wifiMac = wifiNetDevice->GetMac()->GetObject<RegularWifiMac>();
-	//Ptr<DcaTxop> txop = wifiMac->GetDcaTxop();
-	//txop->SetMaxQueueSize(10);
-	PointerValue ptr;
-	wifiMac->GetAttribute("DcaTxop", ptr);
-	Ptr<DcaTxop> txop = ptr.Get<DcaTxop>();
-	Ptr<WifiMacQueue> wifiMacQueue = txop->GetQueue();
-	wifiMacQueue->SetMaxSize(10);
+	m_wifiNetDevice = wifiNetDevice;
+	ResolveMacQueue();
 
 	Ptr<WifiPhy> phy = wifiNetDevice->GetPhy();
 	m_channelNumber = phy->GetChannelNumber();
+	//every frame the phy starts to send has left the mac queue; TxOk/TxErr,
+	//hooked in ResolveMacQueue(), cover the end of unicast exchanges.
+	//Both mean we may have room again.
+	phy->TraceConnectWithoutContext("PhyTxBegin", MakeCallback(&IPCopeDevice::NotifyTxStart, this));
 	m_node -> RegisterProtocolHandler (MakeCallback (&IPCopeDevice::ReceiveFromDevice, this), 0x0, iface, true);
 	NS_LOG_FUNCTION_NOARGS();
 
@@ -341,6 +365,18 @@ IPCopeDevice::SetInterface (Ptr<NetDevice> iface)
 	//m_cope->Init();
 }
 
+void
+IPCopeDevice::NotifyTxStart(Ptr<const Packet> packet)
+{
+	m_cope->NotifyTxReady(m_copeIfIndex);
+}
+
+void
+IPCopeDevice::NotifyTxDone(const WifiMacHeader & header)
+{
+	m_cope->NotifyTxReady(m_copeIfIndex);
+}
+
 uint16_t
 IPCopeDevice::GetChannelNumber() const
 {
@@ -357,9 +393,7 @@ void
 IPCopeDevice::ReceiveFromDevice (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address& source, const Address& dest, PacketType packetType)
 {
 	NS_LOG_FUNCTION(this<<source<<dest<<protocol);
-	packet->Print(std::cout);
-	std::cout<<std::endl;
-	fflush(stdout);
+	IPCOPE_PACKET_TRACE(m_cope, "device-rx", packet);
 
 	Ptr<Packet> p = packet->Copy();
 	if(protocol != Ipv4L3Protocol::PROT_NUMBER && protocol != IPCopeProtocol::PROT_NUMBER)
@@ -374,13 +408,7 @@ IPCopeDevice::ForwardUp(Ptr<Packet> packet, uint16_t protocol, const Mac48Addres
 {
 	NS_LOG_FUNCTION(this);
 	if(protocol == Ipv4L3Protocol::PROT_NUMBER)
-	{
-		Ipv4Header ipHeader;
-		packet->PeekHeader(ipHeader);
-		ipHeader.Print(std::cout);
-		std::cout<<std::endl;
-		fflush(stdout);
-	}
+		IPCOPE_PACKET_TRACE(m_cope, "device-up", packet);
 	std::vector<Mac48Address>::iterator iter;
 	enum NetDevice::PacketType type;
 	Ptr<Packet> packet_copy = packet->Copy();
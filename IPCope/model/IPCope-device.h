@@ -103,8 +103,13 @@ public:
 	void SetCopeProtocol(Ptr<IPCopeProtocol> cope);
 	bool IsQueueFull() const;
 	uint32_t GetMacQueueSize() const;
+	uint32_t GetFreeSlots() const; //room left in the mac queue
 
 private:
+	Ptr<WifiMacQueue> GetMacQueue() const;
+	void ResolveMacQueue();
+	void NotifyTxStart(Ptr<const Packet> packet);
+	void NotifyTxDone(const WifiMacHeader & header);
 	void ReceiveFromDevice (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address& source, const Address& dest, PacketType packetType);
 
 private:
@@ -124,6 +129,10 @@ private:
 	Ipv4Mask m_mask;
 	uint32_t m_ipv4Interface;
 	uint16_t m_channelNumber;
+	//see ResolveMacQueue()
+	Ptr<WifiNetDevice> m_wifiNetDevice;
+	Ptr<WifiMac> m_wifiMac;
+	Ptr<WifiMacQueue> m_macQueue;
 
 };//class IPCopeDevice
 }//namespace cope
@@ -21,8 +21,13 @@
 #include "IPCope-hash.h"
 #include <string.h>
 #include "ns3/log.h"
+#include "ns3/global-value.h"
+#include "ns3/boolean.h"
 #include <iostream>
 #include <stdlib.h>
+#include <algorithm>
+#include <streambuf>
+#include <ostream>
 
 namespace ns3{
 namespace ipcope{
@@ -67,30 +72,249 @@ uint32_t Hash(Mac48Address address, uint16_t seq_no)
 }
 */
 
-uint32_t Hash(Ptr<Packet> packet)
+static GlobalValue g_legacyHash ("IPCopeLegacyHash",
+	"Use the original sliding-window packet id hash instead of xxHash32",
+	BooleanValue (false),
+	MakeBooleanChecker ());
+
+/*
+ * xxHash32 fed in pieces; XxHash32 and Hash(packet) both go through it.
+ */
+class XxHash32State
 {
-	NS_LOG_FUNCTION_NOARGS();
-	Ipv4Header ipHeader;
-	Ptr<Packet> replica = packet->Copy();
-	replica->RemoveHeader(ipHeader);
-	uint32_t length = replica->GetSize();
-	uint32_t size = length  + 4 - (length % 4);
-	uint8_t *buffer = new uint8_t[size];
-	memset(buffer, 0, size);
-	replica->CopyData(buffer, size);
-	uint32_t v1 = 0;
-	uint32_t v2 = 0;
-	for(uint32_t i = 0; i<=size-4; i++)
+public:
+	XxHash32State(uint32_t seed);
+	void Update(const uint8_t *data, uint32_t length);
+	uint32_t Digest(void) const;
+private:
+	void Block(const uint8_t *p);
+
+	uint32_t m_seed;
+	uint32_t m_v[4];
+	uint8_t m_tail[16];
+	uint32_t m_tailSize;
+	uint32_t m_length;
+};
+
+/*
+ * The original sliding-window hash fed in pieces: a round for every byte
+ * once a whole word is in the window, and the zero padding added on Digest.
+ */
+class LegacyHashState
+{
+public:
+	LegacyHashState();
+	void Update(const uint8_t *data, uint32_t length);
+	uint32_t Digest(void) const;
+private:
+	uint32_t m_window;
+	uint32_t m_hash;
+	uint32_t m_length;
+};
+
+/*
+ * Takes what Packet::CopyData writes to a stream and passes it to a hash,
+ * dropping the first skip bytes. The packet buffer is handed over in the
+ * pieces it is stored in, so the payload is never copied.
+ */
+template <typename State>
+class HashSink : public std::streambuf
+{
+public:
+	HashSink(State &state, uint32_t skip)
+		: m_state(state), m_skip(skip)
 	{
-		for(int j = 0; j<4; j++)
+	}
+protected:
+	virtual std::streamsize xsputn(const char *s, std::streamsize n)
+	{
+		const uint8_t *p = (const uint8_t *)s;
+		uint32_t length = n;
+		if(m_skip >= length)
+		{
+			m_skip -= length;
+			return n;
+		}
+		p += m_skip;
+		length -= m_skip;
+		m_skip = 0;
+		m_state.Update(p, length);
+		return n;
+	}
+	virtual int_type overflow(int_type c)
+	{
+		if(!traits_type::eq_int_type(c, traits_type::eof()))
 		{
-			v1 = v1<<8;
-			v1 = v1+buffer[i+j];
+			char ch = traits_type::to_char_type(c);
+			xsputn(&ch, 1);
 		}
-		v2 = Hash(v1, v2);
+		return traits_type::not_eof(c);
 	}
-	NS_LOG_DEBUG(v2);
-	return v2;
+private:
+	State &m_state;
+	uint32_t m_skip;
+};
+
+template <typename State>
+static uint32_t
+HashPayload(Ptr<const Packet> packet, uint32_t offset, State state)
+{
+	HashSink<State> sink(state, offset);
+	std::ostream os(&sink);
+	packet->CopyData(&os, packet->GetSize());
+	return state.Digest();
+}
+
+uint32_t Hash(Ptr<const Packet> packet)
+{
+	NS_LOG_FUNCTION_NOARGS();
+	Ipv4Header ipHeader;
+	uint32_t offset = packet->PeekHeader(ipHeader);
+
+	BooleanValue legacy;
+	g_legacyHash.GetValue(legacy);
+	uint32_t pid;
+	if(legacy.Get())
+		pid = HashPayload(packet, offset, LegacyHashState());
+	else
+		pid = HashPayload(packet, offset, XxHash32State(0));
+	NS_LOG_DEBUG(pid);
+	return pid;
+}
+
+/*
+ * The original id: one Hash(v1, v2) round for every byte offset, over the
+ * big-endian word starting there, with the payload zero padded by 1 to 4
+ * bytes.
+ */
+uint32_t LegacyHash(const uint8_t *data, uint32_t length)
+{
+	LegacyHashState state;
+	state.Update(data, length);
+	return state.Digest();
+}
+
+LegacyHashState::LegacyHashState()
+	: m_window(0), m_hash(0), m_length(0)
+{
+}
+
+void
+LegacyHashState::Update(const uint8_t *data, uint32_t length)
+{
+	for(uint32_t i = 0; i < length; i++)
+	{
+		m_window = (m_window << 8) | data[i];
+		if(++m_length >= 4)
+			m_hash = Hash(m_window, m_hash);
+	}
+}
+
+uint32_t
+LegacyHashState::Digest(void) const
+{
+	static const uint8_t zeros[4] = {0, 0, 0, 0};
+	LegacyHashState padded = *this;
+	padded.Update(zeros, 4 - (m_length % 4));
+	return padded.m_hash;
+}
+
+static const uint32_t XXH_PRIME1 = 2654435761u;
+static const uint32_t XXH_PRIME2 = 2246822519u;
+static const uint32_t XXH_PRIME3 = 3266489917u;
+static const uint32_t XXH_PRIME4 = 668265263u;
+static const uint32_t XXH_PRIME5 = 374761393u;
+
+static inline uint32_t
+Rotl32(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t
+Read32(const uint8_t *p)
+{
+	//little endian regardless of the host, as the reference implementation
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t
+XxRound(uint32_t acc, uint32_t input)
+{
+	acc += input * XXH_PRIME2;
+	acc = Rotl32(acc, 13);
+	return acc * XXH_PRIME1;
+}
+
+uint32_t XxHash32(const uint8_t *data, uint32_t length, uint32_t seed)
+{
+	XxHash32State state(seed);
+	state.Update(data, length);
+	return state.Digest();
+}
+
+XxHash32State::XxHash32State(uint32_t seed)
+	: m_seed(seed), m_tailSize(0), m_length(0)
+{
+	m_v[0] = seed + XXH_PRIME1 + XXH_PRIME2;
+	m_v[1] = seed + XXH_PRIME2;
+	m_v[2] = seed;
+	m_v[3] = seed - XXH_PRIME1;
+}
+
+void
+XxHash32State::Block(const uint8_t *p)
+{
+	m_v[0] = XxRound(m_v[0], Read32(p));
+	m_v[1] = XxRound(m_v[1], Read32(p + 4));
+	m_v[2] = XxRound(m_v[2], Read32(p + 8));
+	m_v[3] = XxRound(m_v[3], Read32(p + 12));
+}
+
+void
+XxHash32State::Update(const uint8_t *data, uint32_t length)
+{
+	m_length += length;
+	//finish a block left over from the previous piece
+	if(m_tailSize > 0)
+	{
+		uint32_t n = std::min(16 - m_tailSize, length);
+		memcpy(m_tail + m_tailSize, data, n);
+		m_tailSize += n;
+		data += n;
+		length -= n;
+		if(m_tailSize < 16)
+			return;
+		Block(m_tail);
+		m_tailSize = 0;
+	}
+	for(; length >= 16; data += 16, length -= 16)
+		Block(data);
+	memcpy(m_tail, data, length);
+	m_tailSize = length;
+}
+
+uint32_t
+XxHash32State::Digest(void) const
+{
+	const uint8_t *p = m_tail;
+	const uint8_t *end = m_tail + m_tailSize;
+	uint32_t h32;
+	if(m_length >= 16)
+		h32 = Rotl32(m_v[0], 1) + Rotl32(m_v[1], 7) + Rotl32(m_v[2], 12) + Rotl32(m_v[3], 18);
+	else
+		h32 = m_seed + XXH_PRIME5;
+	h32 += m_length;
+	for(; p + 4 <= end; p += 4)
+		h32 = Rotl32(h32 + Read32(p) * XXH_PRIME3, 17) * XXH_PRIME4;
+	for(; p < end; p++)
+		h32 = Rotl32(h32 + (*p) * XXH_PRIME5, 11) * XXH_PRIME1;
+	h32 ^= h32 >> 15;
+	h32 *= XXH_PRIME2;
+	h32 ^= h32 >> 13;
+	h32 *= XXH_PRIME3;
+	h32 ^= h32 >> 16;
+	return h32;
 }
 
 uint32_t Hash(uint32_t v1, uint32_t v2)
@@ -32,7 +32,16 @@ namespace ipcope{
 
 //uint32_t Hash(Mac48Address address, uint16_t seq_no);
 //uint32_t Hash(Ipv4Address address, uint32_t seq_no);
-uint32_t Hash(Ptr<Packet> packet);
+
+/*
+ * Packet id: a hash of the payload behind the IPv4 header. By default this
+ * is xxHash32; setting the global value IPCopeLegacyHash to true brings back
+ * the original sliding-window hash, for comparing against old runs. Either
+ * hash reads the payload straight out of the packet buffer.
+ */
+uint32_t Hash(Ptr<const Packet> packet);
+uint32_t LegacyHash(const uint8_t *data, uint32_t length);
+uint32_t XxHash32(const uint8_t *data, uint32_t length, uint32_t seed);
 uint32_t Hash(uint32_t v1, uint32_t v2);
 
 }
@@ -63,20 +63,14 @@ IPCopeHeader::Print (std::ostream &os) const
 	std::map<Mac48Address, uint32_t>::const_iterator iter;
 	for(iter = m_pidNexthops.begin(); iter != m_pidNexthops.end(); iter++)
 	{
-		os << (*iter).second << ", " << (*iter).first << ", ";
+		os << (*iter).second << ", " << (*iter).first << ", " << GetNativeLength((*iter).first) << ", " << GetLinkSeq((*iter).first) << ", ";
 	}
 
 	os << "REPORT NUM " << m_reportNum << ", ";
-	/*
 	std::vector<RecpReport>::const_iterator RecpRepIter;
 	for(RecpRepIter = m_receptionReports.begin(); RecpRepIter != m_receptionReports.end(); RecpRepIter++)
 	{
-		os << (*RecpRepIter).address << ", " << (*RecpRepIter).lastPkt << ", " << (int)(*RecpRepIter).bitMap << ", ";
-	}*/
-	std::vector<uint32_t>::const_iterator recpIter;
-	for(recpIter = m_recps.begin(); recpIter != m_recps.end(); recpIter++)
-	{
-		os<<(*recpIter)<<", ";
+		os << (*RecpRepIter).address << ", " << (*RecpRepIter).lastPkt << ", " << std::hex << (*RecpRepIter).bitMap << std::dec << ", ";
 	}
 
 	os << "ACK NUM " << m_ackNum << ", ";
@@ -84,8 +78,7 @@ IPCopeHeader::Print (std::ostream &os) const
 	std::vector<AckBlock>::const_iterator ackBlockIter;
 	for(ackBlockIter = m_ackBlocks.begin(); ackBlockIter != m_ackBlocks.end(); ackBlockIter++)
 	{
-		//os << (*ackBlockIter).address << ", " << (*ackBlockIter).lastAck << ", " << (int)(*ackBlockIter).ackMap ;
-		os<< (*ackBlockIter).address << ", "<<(*ackBlockIter).pid<<", ";
+		os << (*ackBlockIter).address << ", " << (*ackBlockIter).lastAck << ", " << std::hex << (*ackBlockIter).ackMap << std::dec << ", ";
 	}
 }
 
@@ -99,22 +92,17 @@ IPCopeHeader::Serialize(Buffer::Iterator start) const
 	{	
 		WriteTo(start, (*iter).first);
 		start.WriteHtonU32 ((*iter).second);
+		start.WriteHtonU16 (GetNativeLength((*iter).first));
+		start.WriteHtonU16 (GetLinkSeq((*iter).first));
 	}
 	
 	start.WriteHtonU16 (m_reportNum);
-	/*
 	std::vector<RecpReport>::const_iterator RecpRepIter;
 	for(RecpRepIter = m_receptionReports.begin(); RecpRepIter != m_receptionReports.end(); RecpRepIter++)
 	{
 		WriteTo(start, (*RecpRepIter).address);
-		start.WriteHtonU32 ((*RecpRepIter).lastPkt);
-		start.WriteU8 ((*RecpRepIter).bitMap);
-	}
-	*/
-	std::vector<uint32_t>::const_iterator recpIter;
-	for(recpIter = m_recps.begin(); recpIter != m_recps.end(); recpIter++)
-	{
-		start.WriteHtonU32(*recpIter);
+		start.WriteHtonU16 ((*RecpRepIter).lastPkt);
+		start.WriteHtonU32 ((*RecpRepIter).bitMap);
 	}
 
 	start.WriteHtonU16(m_ackNum);
@@ -123,27 +111,24 @@ IPCopeHeader::Serialize(Buffer::Iterator start) const
 	for(ackBlockIter = m_ackBlocks.begin(); ackBlockIter != m_ackBlocks.end(); ackBlockIter++)
 	{
 		WriteTo(start, (*ackBlockIter).address);
-		//start.WriteHtonU32((*ackBlockIter).lastAck);
-		//start.WriteU8((*ackBlockIter).ackMap);
-		start.WriteHtonU32((*ackBlockIter).pid);
+		start.WriteHtonU16((*ackBlockIter).lastAck);
+		start.WriteHtonU32((*ackBlockIter).ackMap);
 	}
 }
 
 uint32_t
 IPCopeHeader::GetSerializedSize() const
 {
-	NS_ASSERT(m_reportNum == m_recps.size());
+	NS_ASSERT(m_reportNum == m_receptionReports.size());
 	NS_ASSERT(m_ackNum == m_ackBlocks.size());
 	return 4 //m_ip
 		+ 2 //m_encodedNum, uint16_t
-		+ (6+4)*(uint32_t)m_pidNexthops.size()
+		+ (6+4+2+2)*(uint32_t)m_pidNexthops.size()
 		+ 2 // m_reportNum, uint16_t
-		//+ (4+4+1)*(uint32_t)m_receptionReports.size() 
-		+ 4 * (uint32_t)m_recps.size()
+		+ (4+2+4)*(uint32_t)m_receptionReports.size()
 		+ 2 //m_ackNum, uint16_t
 		//+ 2 //m_localPktSeqNum
-		//+ (4+4+1)*(uint32_t)m_ackBlocks.size();
-		+(4+4)*(uint32_t)m_ackBlocks.size();
+		+ (4+2+4)*(uint32_t)m_ackBlocks.size();
 }
 
 uint32_t
@@ -153,6 +138,8 @@ IPCopeHeader::Deserialize (Buffer::Iterator start)
 	ReadFrom(bufIter, m_ip);
 	m_encodedNum = bufIter.ReadNtohU16();
 	m_pidNexthops.clear();
+	m_nativeLengths.clear();
+	m_linkSeqs.clear();
 	uint32_t pktId;
 	Mac48Address add;
 	for(int i = 0; i<m_encodedNum; i++)
@@ -160,26 +147,20 @@ IPCopeHeader::Deserialize (Buffer::Iterator start)
 		ReadFrom(bufIter, add);
 		pktId = bufIter.ReadNtohU32();
 		m_pidNexthops.insert(std::make_pair(add, pktId));
+		m_nativeLengths.insert(std::make_pair(add, bufIter.ReadNtohU16()));
+		m_linkSeqs.insert(std::make_pair(add, bufIter.ReadNtohU16()));
 	}
 
 	m_reportNum = bufIter.ReadNtohU16();
-	/*
 	RecpReport report;
 	m_receptionReports.clear();
 	for(int i = 0; i<m_reportNum; i++)
 	{
 		ReadFrom(bufIter, report.address);
-		report.lastPkt = bufIter.ReadNtohU32();
-		report.bitMap = bufIter.ReadU8();
+		report.lastPkt = bufIter.ReadNtohU16();
+		report.bitMap = bufIter.ReadNtohU32();
 		m_receptionReports.push_back(report);
 	}
-	*/
-	m_recps.clear();
-	for(int i = 0; i<m_reportNum; i++)
-	{
-		uint32_t id = bufIter.ReadNtohU32();
-		m_recps.push_back(id);
-	}
 
 	m_ackNum = bufIter.ReadNtohU16();
 	//m_localPktSeqNum = bufIter.ReadNtohU16();
@@ -188,9 +169,8 @@ IPCopeHeader::Deserialize (Buffer::Iterator start)
 	for(int i = 0; i<m_ackNum; i++)
 	{
 		ReadFrom(bufIter, ack.address);
-		//ack.lastAck = bufIter.ReadNtohU32();
-		//ack.ackMap = bufIter.ReadU8();
-		ack.pid = bufIter.ReadNtohU32();
+		ack.lastAck = bufIter.ReadNtohU16();
+		ack.ackMap = bufIter.ReadNtohU32();
 		m_ackBlocks.push_back(ack);
 	}
 
@@ -199,33 +179,83 @@ IPCopeHeader::Deserialize (Buffer::Iterator start)
 	return dist;
 }
 
-std::vector<uint32_t>
+std::vector<RecpReport>
 IPCopeHeader::GetRecpReports() const
 {
 	NS_LOG_FUNCTION_NOARGS();
-	return m_recps;
+	return m_receptionReports;
+}
+
+static std::vector<uint16_t>
+ExpandBitMap(uint16_t last, uint32_t bitMap)
+{
+	std::vector<uint16_t> ids;
+	ids.push_back(last);
+	for(uint16_t i = 0; i<32; i++)
+	{
+		if(bitMap & (1u << i))
+			ids.push_back((uint16_t)(last - 1 - i));
+	}
+	return ids;
+}
+
+std::vector<uint16_t>
+IPCopeHeader::Expand(const RecpReport & report)
+{
+	return ExpandBitMap(report.lastPkt, report.bitMap);
+}
+
+std::vector<uint16_t>
+IPCopeHeader::Expand(const AckBlock & ack)
+{
+	return ExpandBitMap(ack.lastAck, ack.ackMap);
 }
 
 uint16_t
 IPCopeHeader::GetReportNum() const
 {
 	NS_LOG_FUNCTION(this<<m_reportNum);
-	NS_ASSERT(m_recps.size() == m_reportNum);
+	NS_ASSERT(m_receptionReports.size() == m_reportNum);
 	return m_reportNum;
 }
 
 bool
-IPCopeHeader::AddIdNexthop(const Mac48Address & nexthop, uint32_t pktId)
+IPCopeHeader::AddIdNexthop(const Mac48Address & nexthop, uint32_t pktId, uint16_t length)
 {
 	NS_LOG_FUNCTION_NOARGS();
 	if(m_pidNexthops.find(nexthop) != m_pidNexthops.end())
 		return false;
 	NS_ASSERT(GetEncodedNum() < 65536);//2^16 = 65536
 	m_pidNexthops.insert(std::make_pair(nexthop, pktId));
+	m_nativeLengths.insert(std::make_pair(nexthop, length));
 	m_encodedNum++;
 	return true;
 }
 
+uint16_t
+IPCopeHeader::GetNativeLength(const Mac48Address & nexthop) const
+{
+	std::map<Mac48Address, uint16_t>::const_iterator iter = m_nativeLengths.find(nexthop);
+	NS_ASSERT(iter != m_nativeLengths.end());
+	return iter->second;
+}
+
+void
+IPCopeHeader::SetLinkSeq(const Mac48Address & nexthop, uint16_t seq)
+{
+	NS_ASSERT(m_pidNexthops.find(nexthop) != m_pidNexthops.end());
+	m_linkSeqs[nexthop] = seq;
+}
+
+uint16_t
+IPCopeHeader::GetLinkSeq(const Mac48Address & nexthop) const
+{
+	std::map<Mac48Address, uint16_t>::const_iterator iter = m_linkSeqs.find(nexthop);
+	if(iter == m_linkSeqs.end())
+		return 0;
+	return iter->second;
+}
+
 uint16_t
 IPCopeHeader::GetEncodedNum() const
 {
@@ -359,42 +389,19 @@ IPCopeHeader::Search(const std::vector<AckBlock> ackVec, const Ipv4Address & add
 	return false;
 }
 
-std::vector<uint32_t>
-IPCopeHeader::Search(const std::vector<AckBlock> ackVec, const Ipv4Address & addr)
+bool
+IPCopeHeader::AddRecpReport(const RecpReport & report)
 {
-	NS_LOG_FUNCTION(this<<"pids we should retrieve from Search: "<<ackVec.size());
-	std::vector<uint32_t> pids;
-	std::vector<AckBlock>::const_iterator iter;
-	for(iter = ackVec.begin(); iter!= ackVec.end(); iter++)
+	NS_LOG_FUNCTION(this<<report.address<<report.lastPkt);
+	std::vector<RecpReport>::const_iterator iter;
+	for(iter = m_receptionReports.begin(); iter != m_receptionReports.end(); iter++)
 	{
-		if(iter->address == addr)
-			pids.push_back(iter->pid);
+		if(iter->address == report.address && iter->lastPkt == report.lastPkt)
+			return false;
 	}
-	return pids;
-}
-
-bool
-IPCopeHeader::AddRecpReport(uint32_t pid)
-{
-	NS_LOG_FUNCTION_NOARGS();
-	if(find(m_recps.begin(), m_recps.end(), pid) != m_recps.end())
-		return false;
-	m_recps.push_back(pid);
+	m_receptionReports.push_back(report);
 	m_reportNum++;
-	NS_ASSERT(m_reportNum == m_recps.size());
-	return true;
-}
-
-bool
-IPCopeHeader::AddAckBlock(const Ipv4Address & address, uint32_t pid)
-{
-	if(!Search(m_ackBlocks, address).size())
-		return false;
-	AckBlock ackBlock;
-	ackBlock.address = address;
-	ackBlock.pid = pid;
-	m_ackBlocks.push_back(ackBlock);
-	m_ackNum++;
+	NS_ASSERT(m_reportNum == m_receptionReports.size());
 	return true;
 }
 
@@ -515,7 +522,8 @@ IPCopeType::IsData() const
 	return (m_type == DATA);
 }
 
-IPCopeHello::IPCopeHello()
+IPCopeHello::IPCopeHello():
+	m_seq(0)
 {
 }
 
@@ -548,6 +556,7 @@ IPCopeHello::Print (std::ostream &os) const
 		os<<"mac: "<<iter->mac<<", ";
 		os<<"ch#: "<<iter->channel;
 	}
+	os<<" seq: "<<m_seq<<", "<<m_linkReports.size()<<" link reports";
 	os.flush();
 }
 
@@ -562,12 +571,20 @@ IPCopeHello::Serialize(Buffer::Iterator start) const
 		WriteTo(start, iter->mac);
 		start.WriteHtonU16(iter->channel);
 	}
+	start.WriteHtonU16(m_seq);
+	start.WriteU8(m_linkReports.size());
+	std::vector<LinkReport>::const_iterator reportIter;
+	for(reportIter = m_linkReports.begin(); reportIter != m_linkReports.end(); reportIter++)
+	{
+		WriteTo(start, reportIter->from);
+		start.WriteU8(reportIter->delivery);
+	}
 }
 
 uint32_t
 IPCopeHello::GetSerializedSize() const
 {
-	return 1+(4+6+2)*(uint32_t)m_addPair.size();
+	return 1+(4+6+2)*(uint32_t)m_addPair.size()+2+1+(6+1)*(uint32_t)m_linkReports.size();
 }
 
 uint32_t
@@ -584,6 +601,16 @@ IPCopeHello::Deserialize (Buffer::Iterator start)
 		pair.channel = bufIter.ReadNtohU16();
 		m_addPair.push_back(pair);
 	}
+	m_seq = bufIter.ReadNtohU16();
+	uint8_t reportNum = bufIter.ReadU8();
+	m_linkReports.clear();
+	for(uint8_t i = 0; i<reportNum; i++)
+	{
+		LinkReport report;
+		ReadFrom(bufIter, report.from);
+		report.delivery = bufIter.ReadU8();
+		m_linkReports.push_back(report);
+	}
 	uint32_t dist = bufIter.GetDistanceFrom(start);
 	NS_ASSERT(dist == GetSerializedSize());
 	return dist;
@@ -610,5 +637,30 @@ IPCopeHello::Get(uint8_t index) const
 	return m_addPair[index];
 }
 
+void
+IPCopeHello::SetSequence(uint16_t seq)
+{
+	m_seq = seq;
+}
+
+uint16_t
+IPCopeHello::GetSequence() const
+{
+	return m_seq;
+}
+
+void
+IPCopeHello::SetLinkReports(const std::vector<LinkReport> & reports)
+{
+	NS_ASSERT(reports.size() <= 255);
+	m_linkReports = reports;
+}
+
+const std::vector<LinkReport> &
+IPCopeHello::GetLinkReports() const
+{
+	return m_linkReports;
+}
+
 }//namespace cope
 }//namespace ns3
@@ -37,14 +37,32 @@ enum MessageType {
 	DATA = 2,
 };
 
+/*
+ * Acks what a neighbor sent us coded, by its per-link sequence numbers:
+ * lastAck itself and lastAck-1-i for every bit i set in ackMap.
+ */
 struct AckBlockStruct
 {
-	Ipv4Address address;
-	uint32_t pid;
+	Ipv4Address address; //of the neighbor being acked
+	uint16_t lastAck;
+	uint32_t ackMap;
 };
 
 typedef struct AckBlockStruct AckBlock;
 
+/*
+ * Natives overheard from one source, named by their IP identification:
+ * lastPkt itself and lastPkt-1-i for every bit i set in bitMap.
+ */
+struct RecpReportStruct
+{
+	Ipv4Address address;
+	uint16_t lastPkt;
+	uint32_t bitMap;
+};
+
+typedef struct RecpReportStruct RecpReport;
+
 class IPCopeType : public Header
 {
 public:
@@ -73,6 +91,17 @@ struct AddressStruct
 
 typedef struct AddressStruct AddressPair;
 
+/*
+ * How well the sender of a hello hears from, in 1/255ths of the hellos.
+ */
+struct LinkReportStruct
+{
+	Mac48Address from;
+	uint8_t delivery;
+};
+
+typedef struct LinkReportStruct LinkReport;
+
 class IPCopeHello : public Header
 {
 public:
@@ -88,8 +117,14 @@ public:
 	uint8_t GetLength() const;
 	void Add(const Ipv4Address & ip, const Mac48Address & mac, uint16_t channel);
 	AddressPair Get(uint8_t index) const;
+	void SetSequence(uint16_t seq);
+	uint16_t GetSequence() const;
+	void SetLinkReports(const std::vector<LinkReport> & reports);
+	const std::vector<LinkReport> & GetLinkReports() const;
 private:
 	std::vector<AddressPair> m_addPair;
+	uint16_t m_seq;
+	std::vector<LinkReport> m_linkReports;
 };
 
 class IPCopeHeader : public Header
@@ -104,7 +139,11 @@ public:
 	virtual uint32_t Deserialize (Buffer::Iterator start);
 	virtual uint32_t GetSerializedSize (void) const;
 
-	bool AddIdNexthop(const Mac48Address & nexthop, uint32_t pktId);
+	bool AddIdNexthop(const Mac48Address & nexthop, uint32_t pktId, uint16_t length);
+	uint16_t GetNativeLength(const Mac48Address & nexthop) const;
+	//per-link sequence number of the native for nexthop
+	void SetLinkSeq(const Mac48Address & nexthop, uint16_t seq);
+	uint16_t GetLinkSeq(const Mac48Address & nexthop) const;
 
 	uint16_t GetEncodedNum() const;
 	void SetEncodedNum(uint16_t encodedNum);
@@ -113,15 +152,15 @@ public:
 	bool AmINext(const Mac48Address & mac, uint32_t &pid) const;
 	bool AmINext(std::vector<Mac48Address> macs, uint32_t &pid) const;
 
-	bool AddRecpReport(uint32_t pid);
-	bool AddAckBlock(const Ipv4Address & address, uint32_t pid);
+	bool AddRecpReport(const RecpReport & report);
 	void AddAckBlock(std::vector<AckBlock> ackBlock);
 	void AddAckBlock(AckBlock ackblock);
 
 	bool Search(const std::vector<AckBlock> ackVec, const Ipv4Address & mac, AckBlock* ackblock) const;
-	std::vector<uint32_t> Search(const std::vector<AckBlock> ackVec, const Ipv4Address & addr);
+	static std::vector<uint16_t> Expand(const AckBlock & ack);
 
-	std::vector<uint32_t> GetRecpReports() const ;
+	std::vector<RecpReport> GetRecpReports() const ;
+	static std::vector<uint16_t> Expand(const RecpReport & report);
 	uint16_t GetReportNum() const; 
 	void SetReportNum(uint16_t reportNum);
 	void SetAckNum(uint16_t ackNum);
@@ -134,10 +173,11 @@ private:
 	Ipv4Address m_ip;
 	uint16_t m_encodedNum;
 	std::map<Mac48Address, uint32_t> m_pidNexthops;
+	std::map<Mac48Address, uint16_t> m_nativeLengths; //original size of each native, coded payload is the longest
+	std::map<Mac48Address, uint16_t> m_linkSeqs;
 
 	uint16_t m_reportNum;
-	//std::vector<RecpReport> m_receptionReports;
-	std::vector<uint32_t> m_recps;
+	std::vector<RecpReport> m_receptionReports;
 	uint16_t m_ackNum;
 	//uint16_t m_localPktSeqNum;
 	std::vector<AckBlock> m_ackBlocks;
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#include "IPCope-link-estimator.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <math.h>
+
+NS_LOG_COMPONENT_DEFINE("IPCopeLinkEstimator");
+
+namespace ns3{
+namespace ipcope{
+
+IPCopeLinkEstimator::IPCopeLinkEstimator():
+	m_weight(0.1),
+	m_helloPeriod(Seconds(0))
+{}
+
+IPCopeLinkEstimator::~IPCopeLinkEstimator(){}
+
+void
+IPCopeLinkEstimator::SetWeight(double weight)
+{
+	NS_ASSERT(weight > 0 && weight <= 1);
+	m_weight = weight;
+}
+
+double
+IPCopeLinkEstimator::GetWeight() const
+{
+	return m_weight;
+}
+
+void
+IPCopeLinkEstimator::SetHelloPeriod(Time period)
+{
+	m_helloPeriod = period;
+}
+
+Time
+IPCopeLinkEstimator::GetHelloPeriod() const
+{
+	return m_helloPeriod;
+}
+
+/*
+ * Hello periods that have passed since heard without a hello.
+ */
+uint32_t
+IPCopeLinkEstimator::Missed(Time heard) const
+{
+	if(m_helloPeriod.IsZero())
+		return 0;
+	return (uint32_t)floor((Simulator::Now() - heard).GetSeconds() / m_helloPeriod.GetSeconds());
+}
+
+double
+IPCopeLinkEstimator::Decay(Time heard) const
+{
+	return pow(1 - m_weight, (double)Missed(heard));
+}
+
+void
+IPCopeLinkEstimator::Expire()
+{
+	std::tr1::unordered_map<Mac48Address, Inbound, Mac48AddressHash>::iterator inIter = m_inbound.begin();
+	while(inIter != m_inbound.end())
+	{
+		if(Missed(inIter->second.heard) >= IPCOPE_LINK_MAX_MISSED)
+		{
+			NS_LOG_LOGIC("link from "<<inIter->first<<" timed out");
+			m_inbound.erase(inIter++);
+		}
+		else
+			inIter++;
+	}
+	std::tr1::unordered_map<Mac48Address, Reported, Mac48AddressHash>::iterator reportIter = m_reported.begin();
+	while(reportIter != m_reported.end())
+	{
+		if(Missed(reportIter->second.heard) >= IPCOPE_LINK_MAX_MISSED)
+			m_reported.erase(reportIter++);
+		else
+			reportIter++;
+	}
+}
+
+void
+IPCopeLinkEstimator::HelloReceived(const Mac48Address & from, uint16_t seq)
+{
+	Expire();
+	std::tr1::unordered_map<Mac48Address, Inbound, Mac48AddressHash>::iterator iter = m_inbound.find(from);
+	if(iter == m_inbound.end())
+	{
+		Inbound link = {seq, 1.0, Simulator::Now()};
+		m_inbound.insert(std::make_pair(from, link));
+		return;
+	}
+	uint16_t gap = seq - iter->second.lastSeq;
+	//a duplicate, or a neighbor that restarted its sequence numbers
+	if(gap == 0 || gap > 0x8000)
+		gap = 1;
+	//every lost hello is a zero sample, this one is a one
+	double delivery = iter->second.delivery * pow(1 - m_weight, gap - 1);
+	iter->second.delivery = delivery * (1 - m_weight) + m_weight;
+	iter->second.lastSeq = seq;
+	iter->second.heard = Simulator::Now();
+	NS_LOG_LOGIC("from "<<from<<" lost "<<gap - 1<<" hellos, delivery "<<iter->second.delivery);
+}
+
+double
+IPCopeLinkEstimator::GetInbound(const Mac48Address & from) const
+{
+	std::tr1::unordered_map<Mac48Address, Inbound, Mac48AddressHash>::const_iterator iter = m_inbound.find(from);
+	if(iter == m_inbound.end())
+		return 0;
+	return iter->second.delivery * Decay(iter->second.heard);
+}
+
+std::vector<LinkReport>
+IPCopeLinkEstimator::GetReports() const
+{
+	std::vector<LinkReport> reports;
+	std::tr1::unordered_map<Mac48Address, Inbound, Mac48AddressHash>::const_iterator iter;
+	for(iter = m_inbound.begin(); iter != m_inbound.end() && reports.size() < 255; iter++)
+	{
+		LinkReport report;
+		report.from = iter->first;
+		report.delivery = (uint8_t)(GetInbound(iter->first) * 255 + 0.5);
+		reports.push_back(report);
+	}
+	return reports;
+}
+
+void
+IPCopeLinkEstimator::SetReports(const Mac48Address & reporter, const std::vector<LinkReport> & reports)
+{
+	Reported & reported = m_reported[reporter];
+	reported.reports = reports;
+	reported.heard = Simulator::Now();
+}
+
+double
+IPCopeLinkEstimator::GetDelivery(const Mac48Address & from, const Mac48Address & to) const
+{
+	std::tr1::unordered_map<Mac48Address, Reported, Mac48AddressHash>::const_iterator iter = m_reported.find(to);
+	if(iter == m_reported.end())
+		return 0;
+	//a report that is getting old says less and less about the link
+	std::vector<LinkReport>::const_iterator reportIter;
+	for(reportIter = iter->second.reports.begin(); reportIter != iter->second.reports.end(); reportIter++)
+		if(reportIter->from == from)
+			return reportIter->delivery / 255.0 * Decay(iter->second.heard);
+	return 0;
+}
+
+}//namespace ipcope
+}//namespace ns3
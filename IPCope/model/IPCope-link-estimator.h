@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#ifndef COPELINKESTIMATOR_H
+#define COPELINKESTIMATOR_H
+
+#include "ns3/mac48-address.h"
+#include "ns3/nstime.h"
+#include "IPCope-header.h"
+#include "IPCope-neighbor.h"
+#include <vector>
+#include <tr1/unordered_map>
+
+namespace ns3{
+namespace ipcope{
+
+#define IPCOPE_LINK_MAX_MISSED 8 //hello periods without a word before a link or report is dropped
+
+/*
+ * Delivery ratios of the links around this node. Inbound links are
+ * measured from the gaps in hello sequence numbers, smoothed with an EWMA,
+ * and advertised in our own hellos; what the neighbors advertise tells how
+ * well they hear from the nodes around them. A neighbor that goes quiet
+ * counts a lost hello for every hello period since it was last heard,
+ * and is forgotten after IPCOPE_LINK_MAX_MISSED of them.
+ */
+class IPCopeLinkEstimator
+{
+public:
+	IPCopeLinkEstimator();
+	~IPCopeLinkEstimator();
+
+	void SetWeight(double weight); //of the newest sample
+	double GetWeight() const;
+	//longest gap between two hellos of a neighbor; zero never decays
+	void SetHelloPeriod(Time period);
+	Time GetHelloPeriod() const;
+	void Expire(); //drops what hasn't been heard of for too long
+
+	void HelloReceived(const Mac48Address & from, uint16_t seq);
+	double GetInbound(const Mac48Address & from) const;
+	std::vector<LinkReport> GetReports() const;
+
+	//replaces what reporter said earlier
+	void SetReports(const Mac48Address & reporter, const std::vector<LinkReport> & reports);
+	//delivery ratio from one mac to another as advertised by the latter, 0 if unknown
+	double GetDelivery(const Mac48Address & from, const Mac48Address & to) const;
+private:
+	struct Inbound
+	{
+		uint16_t lastSeq;
+		double delivery;
+		Time heard;
+	};
+	struct Reported
+	{
+		std::vector<LinkReport> reports;
+		Time heard;
+	};
+	uint32_t Missed(Time heard) const;
+	double Decay(Time heard) const;
+	std::tr1::unordered_map<Mac48Address, Inbound, Mac48AddressHash> m_inbound;
+	std::tr1::unordered_map<Mac48Address, Reported, Mac48AddressHash> m_reported;
+	double m_weight;
+	Time m_helloPeriod;
+};
+
+}//namespace ipcope
+}//namespace ns3
+
+#endif
@@ -34,7 +34,9 @@ IPCopeNeighbor::IPCopeNeighbor()
 
 IPCopeNeighbor::~IPCopeNeighbor(){}
 
-IPCopeNeighbors::IPCopeNeighbors(){}
+IPCopeNeighbors::IPCopeNeighbors():
+	m_version(0)
+{}
 IPCopeNeighbors::~IPCopeNeighbors(){}
 
 void
@@ -85,73 +87,68 @@ IPCopeNeighbor::GetMac() const
 	return min;
 }
 
-IPCopeQueueEntry*
+void
 IPCopeNeighbor::RemoveVirtualQueueEntry()
 {
 	NS_LOG_FUNCTION_NOARGS();
-	IPCopeQueueEntry* ventry;
-	if(!m_virtualQueue.size())
-		return 0;
-	ventry = m_virtualQueue.front();
-	m_virtualQueue.pop_front();
-	return ventry;
+	if(m_virtualQueue.size())
+		m_virtualQueue.pop_front();
 }
 
-bool
-IPCopeNeighbor::RemoveVirtualQueueEntry(uint32_t packetId)
+IPCopeQueueEntry*
+IPCopeNeighbor::GetVirtualQueueEntry(IPCopeQueue & queue)
 {
-	NS_LOG_FUNCTION_NOARGS();
-	bool isRemoved = false;
-	std::deque<IPCopeQueueEntry *>::iterator iter;
-	for(iter = m_virtualQueue.begin(); iter!= m_virtualQueue.end(); iter++)
+	while(m_virtualQueue.size())
 	{
-		if ((**iter).GetPacketId() == packetId)
-		{
-			m_virtualQueue.erase(iter);
-			isRemoved = true;
-			break;
-		}
+		IPCopeQueueEntry *entry = queue.Get(m_virtualQueue.front());
+		if(entry)
+			return entry;
+		m_virtualQueue.pop_front();
 	}
-	return isRemoved;
+	return 0;
 }
 
-IPCopeQueueEntry*
-IPCopeNeighbor::GetVirtualQueueEntry() const
+uint32_t
+IPCopeNeighbor::PeekVirtualQueue(IPCopeQueue & queue, uint32_t max, std::vector<IPCopeQueueEntry*> & entries)
 {
-	if(!m_virtualQueue.size())
+	uint32_t found = 0;
+	if(!max || !GetVirtualQueueEntry(queue))
 		return 0;
-	else 
-		return m_virtualQueue.front();
+	std::deque<IPCopeQueueHandle>::const_iterator iter;
+	for(iter = m_virtualQueue.begin(); iter != m_virtualQueue.end() && found < max; iter++)
+	{
+		IPCopeQueueEntry *entry = queue.Get(*iter);
+		if(!entry)
+			continue;
+		entries.push_back(entry);
+		found++;
+	}
+	return found;
 }
 
 void
-IPCopeNeighbor::AddVirtualQueueEntryFront(IPCopeQueueEntry * vqe)
+IPCopeNeighbor::AddVirtualQueueEntryFront(const IPCopeQueueHandle & vqe)
 {
 	NS_LOG_FUNCTION_NOARGS();
-	uint32_t id = vqe->GetPacketId();
-	std::deque<IPCopeQueueEntry *>::const_iterator iter;
-	for(iter = m_virtualQueue.begin(); iter != m_virtualQueue.end(); iter++)
-	{
-		if ((**iter).GetPacketId() == id)
-			NS_FATAL_ERROR(this<<"Duplicate packet with id: "<<id);
-	}
-	if(iter == m_virtualQueue.end())
-		m_virtualQueue.push_front(vqe);
+	m_virtualQueue.push_front(vqe);
 }
 
 void
-IPCopeNeighbor::AddVirtualQueueEntry(IPCopeQueueEntry * vqe)
+IPCopeNeighbor::AddVirtualQueueEntry(const IPCopeQueueHandle & vqe)
 {
 	NS_LOG_FUNCTION_NOARGS();
-	uint32_t id = vqe->GetPacketId();
-	std::deque<IPCopeQueueEntry *>::const_iterator iter;
-	for(iter = m_virtualQueue.begin(); iter != m_virtualQueue.end(); iter++)
-	{
-		if ((**iter).GetPacketId() == id)
-			NS_FATAL_ERROR(this<<"Duplicate packet with id: "<<id);
-	}
-	if(iter == m_virtualQueue.end())
-		m_virtualQueue.push_back(vqe);
+	m_virtualQueue.push_back(vqe);
+}
+
+/*
+ * Moves the virtual queue of a neighbor that is merged into this one.
+ */
+void
+IPCopeNeighbor::TakeVirtualQueue(IPCopeNeighbor & neighbor)
+{
+	NS_LOG_FUNCTION(this<<neighbor.m_virtualQueue.size());
+	m_virtualQueue.insert(m_virtualQueue.end(), neighbor.m_virtualQueue.begin(), neighbor.m_virtualQueue.end());
+	neighbor.m_virtualQueue.clear();
 }
 
 /*
@@ -397,8 +394,7 @@ IPCopeNeighbor::AddSoftTrinity(const Ipv4Address & ip, const Mac48Address & mac,
 	}
 	*/
 	m_addressPairs.push_back(trinity);
-	std::cout<<this;
-	fflush(stdout);
+	NS_LOG_LOGIC(*this);
 
 }
 
@@ -419,8 +415,7 @@ IPCopeNeighbor::AddTrinity(const Ipv4Address & ip, const Mac48Address & mac, uin
 		else iter++;
 	}
 	m_addressPairs.push_back(trinity);
-	std::cout<<this;
-	fflush(stdout);
+	NS_LOG_LOGIC(*this);
 }
 
 std::set<uint16_t>
@@ -452,45 +447,81 @@ IPCopeNeighbors::ShareMac(const IPCopeNeighbor & neighbor1, const IPCopeNeighbor
 }
 */
 
-bool
-IPCopeNeighbors::ShareAddress(const IPCopeNeighbor & neighbor1, const IPCopeNeighbor & neighbor2) const
+/*
+ * Points every address of the neighbor at pos to it.
+ */
+void
+IPCopeNeighbors::Index(uint32_t pos)
 {
-	std::deque<Ipv4Address> ips = neighbor1.GetIPs();
-	std::deque<Ipv4Address>::const_iterator ipIter;
-	for(ipIter = ips.begin(); ipIter != ips.end(); ipIter++)
+	std::list<AddressPair> pairs = m_neighbors[pos].GetTrinities();
+	std::list<AddressPair>::const_iterator iter;
+	for(iter = pairs.begin(); iter != pairs.end(); iter++)
 	{
-		if (ipIter->IsEqual("0.0.0.0"))
-			continue;
-		if(neighbor2.HasIP(*ipIter))
-			return true;
+		m_macIndex[iter->mac] = pos;
+		if(!iter->ip.IsEqual("0.0.0.0"))
+			m_ipIndex[iter->ip] = pos;
 	}
-	std::deque<Mac48Address> macs = neighbor1.GetMacs();
-	std::deque<Mac48Address>::const_iterator maciter;
-	for(maciter = macs.begin(); maciter != macs.end(); maciter++)
+}
+
+void
+IPCopeNeighbors::Unindex(uint32_t pos)
+{
+	std::list<AddressPair> pairs = m_neighbors[pos].GetTrinities();
+	std::list<AddressPair>::const_iterator iter;
+	for(iter = pairs.begin(); iter != pairs.end(); iter++)
 	{
-		if(neighbor2.HasMac(*maciter))
-			return true;
+		std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash>::iterator macIter = m_macIndex.find(iter->mac);
+		if(macIter != m_macIndex.end() && macIter->second == pos)
+			m_macIndex.erase(macIter);
+		std::tr1::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::iterator ipIter = m_ipIndex.find(iter->ip);
+		if(ipIter != m_ipIndex.end() && ipIter->second == pos)
+			m_ipIndex.erase(ipIter);
 	}
-	return false;
 }
 
 bool
 IPCopeNeighbors::AddNeighbor(const IPCopeNeighbor& neighbor)
 {
 	NS_LOG_FUNCTION_NOARGS();
-	std::deque<IPCopeNeighbor>::const_iterator iter;
-	for(iter = m_neighbors.begin(); iter != m_neighbors.end(); iter++)
+	std::list<AddressPair> pairs = neighbor.GetTrinities();
+	std::list<AddressPair>::const_iterator iter;
+	for(iter = pairs.begin(); iter != pairs.end(); iter++)
 	{
-		if(ShareAddress (neighbor, *iter))
+		if(SearchNeighbor(iter->mac) > -1 || SearchNeighbor(iter->ip) > -1)
 		{
 			NS_LOG_FUNCTION(this<<"Share address");
 			return false;
 		}
 	}
 	m_neighbors.push_back(neighbor);
+	Index(m_neighbors.size() - 1);
+	m_version++;
 	return true;
 }
 
+void
+IPCopeNeighbors::AddTrinity(NeighborIterator iter, const Ipv4Address & ip, const Mac48Address & mac, uint16_t channel)
+{
+	uint32_t pos = iter - m_neighbors.begin();
+	Mac48Address oldMac = iter->GetMac();
+	Unindex(pos);
+	iter->AddTrinity(ip, mac, channel);
+	Index(pos);
+	if(iter->GetMac() != oldMac)
+		m_version++;
+}
+
+void
+IPCopeNeighbors::AddSoftTrinity(NeighborIterator iter, const AddressPair & pair)
+{
+	uint32_t pos = iter - m_neighbors.begin();
+	Mac48Address oldMac = iter->GetMac();
+	iter->AddSoftTrinity(pair);
+	Index(pos);
+	if(iter->GetMac() != oldMac)
+		m_version++;
+}
+
 /*
 bool
 IPCopeNeighbors::AddNeighbor(IPCopeNeighbor& neighbor, Ipv4Address ipAddr, Ipv4Mask mask)
@@ -510,48 +541,49 @@ IPCopeNeighbors::AddNeighbor(IPCopeNeighbor& neighbor, Ipv4Address ipAddr, Ipv4M
 void
 IPCopeNeighbors::RemoveNeighbor(const Ipv4Address & ip)
 {
-	std::deque<IPCopeNeighbor>::iterator iter;
-	for(iter = m_neighbors.begin(); iter!=m_neighbors.end(); iter++)
-		if(iter->HasIP(ip))
-			m_neighbors.erase(iter);
+	int32_t pos = SearchNeighbor(ip);
+	if(pos > -1)
+		RemoveNeighbor(At(pos));
 }
 
+/*
+ * The last neighbor takes the place of the removed one, so positions and
+ * iterators past the removed neighbor are no longer valid.
+ */
 void
 IPCopeNeighbors::RemoveNeighbor(NeighborIterator iter)
 {
-	m_neighbors.erase(iter);
+	uint32_t pos = iter - m_neighbors.begin();
+	uint32_t last = m_neighbors.size() - 1;
+	Unindex(pos);
+	if(pos != last)
+	{
+		Unindex(last);
+		m_neighbors[pos] = m_neighbors[last];
+		Index(pos);
+	}
+	m_neighbors.pop_back();
+	m_version++;
 }
 
 int32_t
 IPCopeNeighbors::SearchNeighbor(const Ipv4Address & ip) const
 {
 	NS_LOG_FUNCTION_NOARGS();
-	for(int32_t i = 0; i<(int)m_neighbors.size(); i++)
-	{
-		if(m_neighbors[i].HasIP(ip))
-			return i;
-	}
-	return -1;
+	std::tr1::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator iter = m_ipIndex.find(ip);
+	if(iter == m_ipIndex.end())
+		return -1;
+	return iter->second;
 }
 
 int32_t
 IPCopeNeighbors::SearchNeighbor(const Mac48Address & mac) const
 {
 	NS_LOG_FUNCTION(this<<mac<<m_neighbors.size());
-	std::deque<IPCopeNeighbor>::const_iterator neighborIter;
-	int32_t pos = 0;
-	for(neighborIter = m_neighbors.begin(); neighborIter != m_neighbors.end(); neighborIter++)
-	{
-		bool found = neighborIter->HasMac(mac);
-		if(found)
-		{
-			std::cout<<(*neighborIter);
-			return pos;
-		}
-		else
-			pos++;
-	}
-	return -1;
+	std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash>::const_iterator iter = m_macIndex.find(mac);
+	if(iter == m_macIndex.end())
+		return -1;
+	return iter->second;
 }
 
 void
@@ -569,16 +601,14 @@ IPCopeNeighbors::NeighborLearn(const IPCopeHello & hello)
 		if(searchMac > -1)
 		{
 			NeighborIterator iter = At(searchMac);
-			while(iter->GetVirtualQueueEntry())
-				neighbor.AddVirtualQueueEntry(iter->RemoveVirtualQueueEntry());
+			neighbor.TakeVirtualQueue(*iter);
 			RemoveNeighbor(iter);
 		}
 		int32_t searchIp = SearchNeighbor(pair.ip);
 		if(searchIp> -1)
 		{
 			NeighborIterator iter = At(searchIp);
-			while(iter->GetVirtualQueueEntry())
-				neighbor.AddVirtualQueueEntry(iter->RemoveVirtualQueueEntry());
+			neighbor.TakeVirtualQueue(*iter);
 			RemoveNeighbor(iter);
 		}
 		neighbor.AddTrinity(pair);
@@ -620,13 +650,14 @@ IPCopeNeighbors::SMNeighbors(const Ipv4Address & ip, const Mac48Address & mac, c
 	{
 		NS_LOG_LOGIC("found ip but not mac");
 		iter = At(searchIp);
-		iter->AddSoftTrinity(ip, mac, channel);
+		AddressPair pair = {ip, mac, channel};
+		AddSoftTrinity(iter, pair);
 	}
 	else if (searchIp < 0 && searchMac > -1)
 	{
 		NS_LOG_LOGIC("found mac but not ip");
 		iter = At(searchMac);
-		iter->AddTrinity(ip, mac, channel);
+		AddTrinity(iter, ip, mac, channel);
 	}
 	else if(searchIp > -1 && searchMac > -1)
 	{
@@ -641,16 +672,16 @@ IPCopeNeighbors::SMNeighbors(const Ipv4Address & ip, const Mac48Address & mac, c
 			NS_LOG_LOGIC(this<<"Merge");
 			iter = At(searchIp);
 			NeighborIterator iter2 = At(searchMac);
-			iter2->AddTrinity(ip, mac, channel);
-			std::list<AddressPair> trinities = iter2->GetTrinities();
+			iter->TakeVirtualQueue(*iter2);
+			IPCopeNeighbor merged = *iter2;
+			merged.AddTrinity(ip, mac, channel);
+			std::list<AddressPair> trinities = merged.GetTrinities();
+			//drop iter2 first so the merged addresses index to iter, which may move
+			RemoveNeighbor(iter2);
+			iter = At(SearchNeighbor(ip));
 			std::list<AddressPair>::const_iterator tri_iter;
 			for(tri_iter = trinities.begin(); tri_iter != trinities.end(); tri_iter++)
-				iter->AddSoftTrinity(*tri_iter);
-			while(iter2->GetVirtualQueueEntry())
-				iter->AddVirtualQueueEntry(iter2->RemoveVirtualQueueEntry());
-			RemoveNeighbor(iter2);
-			searchIp = SearchNeighbor(ip);
-			iter = At(searchIp);
+				AddSoftTrinity(iter, *tri_iter);
 		}
 	}
 	else //new neighbor
@@ -710,8 +741,7 @@ IPCopeNeighbors::SMNeighbors(const Ipv4Address ip, const Mac48Address mac)
 			std::set<uint16_t>::const_iterator ch_iter;
 			for(ch_iter = chs.begin(); ch_iter != chs.end(); ch_iter++)
 				iter->AddChannel(*ch_iter);
-			while(iter2->GetVirtualQueueEntry())
-				iter->AddVirtualQueueEntry(iter2->RemoveVirtualQueueEntry());
+			iter->TakeVirtualQueue(*iter2);
 			RemoveNeighbor(iter2);
 		}
 	}
@@ -29,10 +29,34 @@
 #include "IPCope-queue.h"
 #include <set>
 #include <list>
+#include <vector>
+#include <tr1/unordered_map>
 
 namespace ns3{
 namespace ipcope{
 
+struct Mac48AddressHash
+{
+	size_t operator() (const Mac48Address & mac) const
+	{
+		uint8_t buffer[6];
+		mac.CopyTo(buffer);
+		uint32_t hash = 2166136261u; //FNV-1a
+		for(uint32_t i = 0; i < 6; i++)
+			hash = (hash ^ buffer[i]) * 16777619u;
+		return hash;
+	}
+};
+
+struct Ipv4AddressHash
+{
+	size_t operator() (const Ipv4Address & ip) const
+	{
+		uint32_t hash = ip.Get() * 2654435761u;
+		return hash ^ (hash >> 16);
+	}
+};
+
 class IPCopeNeighbor
 {
 public:
@@ -40,11 +64,14 @@ public:
 	//IPCopeNeighbor(Mac48Address mac);
 	//IPCopeNeighbor(Ipv4Address ip);
 	~IPCopeNeighbor();
-	void AddVirtualQueueEntry(IPCopeQueueEntry * vqe);
-	void AddVirtualQueueEntryFront(IPCopeQueueEntry * vqe);
-	IPCopeQueueEntry* GetVirtualQueueEntry() const;
-	IPCopeQueueEntry* RemoveVirtualQueueEntry();
-	bool RemoveVirtualQueueEntry(uint32_t packetId);
+	//the virtual queue holds handles into the output queue; entries that left it are skipped
+	void AddVirtualQueueEntry(const IPCopeQueueHandle & vqe);
+	void AddVirtualQueueEntryFront(const IPCopeQueueHandle & vqe);
+	IPCopeQueueEntry* GetVirtualQueueEntry(IPCopeQueue & queue);
+	//appends up to max live entries from the front of the virtual queue, head first
+	uint32_t PeekVirtualQueue(IPCopeQueue & queue, uint32_t max, std::vector<IPCopeQueueEntry*> & entries);
+	void RemoveVirtualQueueEntry();
+	void TakeVirtualQueue(IPCopeNeighbor & neighbor);
 	Ipv4Address GetIp() const ;
 	//uint32_t AddIP(const Ipv4Address & addr);
 	std::deque<Ipv4Address> GetIPs() const;
@@ -74,12 +101,19 @@ private:
 	std::set<uint16_t> m_channels;
 	*/
 	std::list<AddressPair> m_addressPairs;
-	std::deque<IPCopeQueueEntry *> m_virtualQueue;
+	std::deque<IPCopeQueueHandle> m_virtualQueue;
 };
 
 std::ostream & operator<< (std::ostream & os, const IPCopeNeighbor& neighbor);
 
 
+/*
+ * Neighbors live in a flat array with a mac -> position and an ip -> position
+ * index on top, so both searches are a single hash lookup. Addresses must be
+ * changed through AddTrinity/AddSoftTrinity here rather than on the neighbor
+ * itself to keep the indices in sync. 0.0.0.0 stands for an unknown ip and
+ * is never indexed.
+ */
 class IPCopeNeighbors
 {
 public:
@@ -87,7 +121,7 @@ public:
 	~IPCopeNeighbors();
 	
 	//typedef std::set<IPCopeNeighbor>::iterator NeighborIterator;
-	typedef std::deque<IPCopeNeighbor>::iterator NeighborIterator;
+	typedef std::vector<IPCopeNeighbor>::iterator NeighborIterator;
 	NeighborIterator SMNeighbors(const Ipv4Address & ip, const Mac48Address & mac, const uint16_t channel);
 	//NeighborIterator SMNeighbors(const Ipv4Address ip, const Mac48Address mac);
 	//NeighborIterator UpdateNeighbors(const Ipv4Address ip, const Mac48Address mac);
@@ -100,16 +134,24 @@ public:
 	int32_t SearchNeighbor(const Ipv4Address & ip) const;
 	int32_t SearchNeighbor(const Mac48Address & mac) const;
 	NeighborIterator At(int32_t pos);
+	void AddTrinity(NeighborIterator iter, const Ipv4Address & ip, const Mac48Address & mac, uint16_t channel);
+	void AddSoftTrinity(NeighborIterator iter, const AddressPair & pair);
 
 	void NeighborLearn(const IPCopeHello & hello);
+	//bumped whenever a neighbor comes, goes or changes its GetMac()
+	uint32_t GetVersion() const { return m_version; }
 	//std::deque<IPCopeNeighbor> GetIPCopeNeighborSet() const;
 	
 
 private:
-	bool ShareAddress(const IPCopeNeighbor &, const IPCopeNeighbor &) const;
+	void Index(uint32_t pos);
+	void Unindex(uint32_t pos);
 	
 	//std::set<IPCopeNeighbor> m_neighbors;
-	std::deque<IPCopeNeighbor> m_neighbors;
+	std::vector<IPCopeNeighbor> m_neighbors;
+	std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash> m_macIndex;
+	std::tr1::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash> m_ipIndex;
+	uint32_t m_version;
 };
 
 }//namespace cope
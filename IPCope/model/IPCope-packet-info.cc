@@ -19,6 +19,7 @@
 
 #include "IPCope-packet-info.h"
 #include "ns3/log.h"
+#include "ns3/simulator.h"
 #include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE("IPCopePacketInfo");
@@ -26,7 +27,11 @@ NS_LOG_COMPONENT_DEFINE("IPCopePacketInfo");
 namespace ns3{
 namespace ipcope{
 
-IPCopePacketInfo::IPCopePacketInfo(){}
+IPCopePacketInfo::IPCopePacketInfo():
+	m_packetInfo(256),
+	m_used(0),
+	m_maxAge(Seconds(0))
+{}
 IPCopePacketInfo::~IPCopePacketInfo(){}
 
 /*
@@ -85,40 +90,253 @@ IPCopePacketInfo::SetProbability(uint32_t packetId, Neighbor neighbor, double pr
 }
 */
 
-bool
-IPCopePacketInfo::GetItem(uint32_t packetId, const Mac48Address & add)
+uint32_t
+IPCopePacketInfo::NeighborId(const Mac48Address & mac)
 {
-	NS_LOG_FUNCTION(this<<m_packetInfo.size()<<packetId<<add);
-	//std::map<uint32_t, Mac48Address>::const_iterator iter = m_packetInfo.find(packetId);
-	std::map<uint32_t, std::vector<Mac48Address> >::const_iterator iter = m_packetInfo.find(packetId);
-	if(iter == m_packetInfo.end())
-		return false;
-	/*
-	if (iter->second == add)
-		return true;
+	std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash>::const_iterator iter = m_neighborIds.find(mac);
+	if(iter != m_neighborIds.end())
+		return iter->second;
+	uint32_t id;
+	if(m_freeIds.size())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+		m_neighborMacs[id] = mac;
+	}
+	else if(m_neighborMacs.size() < IPCOPE_MAX_NEIGHBORS)
+	{
+		id = m_neighborMacs.size();
+		m_neighborMacs.push_back(mac);
+	}
 	else
+	{
+		NS_LOG_WARN("More than "<<IPCOPE_MAX_NEIGHBORS<<" neighbors, not tracking "<<mac);
+		return IPCOPE_NO_NEIGHBOR;
+	}
+	m_neighborIds.insert(std::make_pair(mac, id));
+	NS_LOG_LOGIC("neighbor "<<mac<<" has id "<<id);
+	return id;
+}
+
+bool
+IPCopePacketInfo::FindNeighborId(const Mac48Address & mac, uint32_t & id) const
+{
+	std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash>::const_iterator iter = m_neighborIds.find(mac);
+	if(iter == m_neighborIds.end())
 		return false;
-		*/
-	if(find(iter->second.begin(), iter->second.end(), add) == iter->second.end())
+	id = iter->second;
+	return true;
+}
+
+bool
+IPCopePacketInfo::IsNeighborId(uint32_t id) const
+{
+	uint32_t found;
+	return id < m_neighborMacs.size() && FindNeighborId(m_neighborMacs[id], found) && found == id;
+}
+
+Mac48Address
+IPCopePacketInfo::NeighborMac(uint32_t id) const
+{
+	NS_ASSERT(id < m_neighborMacs.size());
+	return m_neighborMacs[id];
+}
+
+void
+IPCopePacketInfo::RenameNeighbor(uint32_t id, const Mac48Address & mac)
+{
+	NS_LOG_FUNCTION(this<<id<<mac);
+	NS_ASSERT(IsNeighborId(id));
+	NS_ASSERT(m_neighborIds.find(mac) == m_neighborIds.end());
+	m_neighborIds.erase(m_neighborMacs[id]);
+	m_neighborIds.insert(std::make_pair(mac, id));
+	m_neighborMacs[id] = mac;
+}
+
+void
+IPCopePacketInfo::ReleaseNeighbor(uint32_t id)
+{
+	NS_LOG_FUNCTION(this<<id<<m_used);
+	NS_ASSERT(IsNeighborId(id));
+	m_neighborIds.erase(m_neighborMacs[id]);
+	m_neighborMacs[id] = Mac48Address();
+	std::vector<InfoSlot>::iterator iter;
+	for(iter = m_packetInfo.begin(); iter != m_packetInfo.end(); iter++)
+		if(iter->used)
+			iter->holders.Clear(id);
+	m_freeIds.push_back(id);
+}
+
+/*
+ * Slot holding packetId, or the empty slot where it would go. The table is
+ * never full, so the walk always ends.
+ */
+int32_t
+IPCopePacketInfo::Probe(uint32_t packetId) const
+{
+	uint32_t mask = m_packetInfo.size() - 1;
+	//pids are hashes already, the multiply just spreads sequential ones
+	uint32_t pos = (packetId * 2654435761u) & mask;
+	while(m_packetInfo[pos].used && m_packetInfo[pos].pid != packetId)
+		pos = (pos + 1) & mask;
+	return pos;
+}
+
+NeighborBitmap
+IPCopePacketInfo::Holders(uint32_t packetId) const
+{
+	const InfoSlot & slot = m_packetInfo[Probe(packetId)];
+	if(!slot.used)
+		return NeighborBitmap();
+	return slot.holders;
+}
+
+bool
+IPCopePacketInfo::GetItem(uint32_t packetId, const Mac48Address & add) const
+{
+	NS_LOG_FUNCTION(this<<m_used<<packetId<<add);
+	std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash>::const_iterator iter = m_neighborIds.find(add);
+	if(iter == m_neighborIds.end())
 		return false;
-	else return true;
+	return Holders(packetId).Test(iter->second);
 }
 
 void
 IPCopePacketInfo::SetItem(uint32_t packetId, const Mac48Address & add)
 {
-	NS_LOG_FUNCTION(this<<packetId<<add<<m_packetInfo.size());
-	//m_packetInfo.insert(std::make_pair(packetId, add));
-	std::map<uint32_t, std::vector<Mac48Address> >::iterator iter = m_packetInfo.find(packetId);
-	if(iter == m_packetInfo.end())
+	NS_LOG_FUNCTION(this<<packetId<<add<<m_used);
+	uint32_t id = NeighborId(add);
+	if(id == IPCOPE_NO_NEIGHBOR)
+		return;
+	InfoSlot & slot = Insert(packetId);
+	slot.holders.Set(id);
+	slot.stamp = Simulator::Now();
+}
+
+void
+IPCopePacketInfo::SetPrevHop(uint32_t packetId, const Mac48Address & mac)
+{
+	NS_LOG_FUNCTION(this<<packetId<<mac);
+	InfoSlot & slot = Insert(packetId);
+	slot.hasPrevHop = true;
+	slot.prevHop = mac;
+	slot.stamp = Simulator::Now();
+}
+
+bool
+IPCopePacketInfo::GetPrevHop(uint32_t packetId, Mac48Address & mac) const
+{
+	const InfoSlot & slot = m_packetInfo[Probe(packetId)];
+	if(!slot.used || !slot.hasPrevHop)
+		return false;
+	mac = slot.prevHop;
+	return true;
+}
+
+static uint64_t
+AliasKey(const Ipv4Address & source, uint16_t ipId)
+{
+	return ((uint64_t)source.Get() << 16) | ipId;
+}
+
+void
+IPCopePacketInfo::SetAlias(const Ipv4Address & source, uint16_t ipId, uint32_t packetId)
+{
+	uint64_t key = AliasKey(source, ipId);
+	std::pair<std::tr1::unordered_map<uint64_t, uint32_t>::iterator, bool> result = m_aliases.insert(std::make_pair(key, packetId));
+	if(!result.second)
 	{
-		std::vector<Mac48Address> vec;
-		vec.push_back(add);
-		m_packetInfo.insert(std::make_pair(packetId, vec));
+		result.first->second = packetId;
+		return;
 	}
-	else
-		if(find(iter->second.begin(), iter->second.end(), add) == iter->second.end())
-			iter->second.push_back(add);
+	m_aliasOrder.push_back(key);
+	if(m_aliasOrder.size() > IPCOPE_MAX_ALIASES)
+	{
+		m_aliases.erase(m_aliasOrder.front());
+		m_aliasOrder.pop_front();
+	}
+}
+
+bool
+IPCopePacketInfo::GetAlias(const Ipv4Address & source, uint16_t ipId, uint32_t & packetId) const
+{
+	std::tr1::unordered_map<uint64_t, uint32_t>::const_iterator iter = m_aliases.find(AliasKey(source, ipId));
+	if(iter == m_aliases.end())
+		return false;
+	packetId = iter->second;
+	return true;
+}
+
+/*
+ * The slot of packetId, set up empty if the packet is new.
+ */
+IPCopePacketInfo::InfoSlot &
+IPCopePacketInfo::Insert(uint32_t packetId)
+{
+	InfoSlot * slot = &m_packetInfo[Probe(packetId)];
+	if(!slot->used)
+	{
+		//keep the load factor at or below one half
+		if(2 * (m_used + 1) > m_packetInfo.size())
+		{
+			Rehash();
+			slot = &m_packetInfo[Probe(packetId)];
+		}
+		slot->used = true;
+		slot->pid = packetId;
+		slot->holders = NeighborBitmap();
+		slot->hasPrevHop = false;
+		m_used++;
+	}
+	return *slot;
+}
+
+/*
+ * Rebuilds the table without the aged-out entries, doubling it if that
+ * alone doesn't free enough room.
+ */
+void
+IPCopePacketInfo::Rehash()
+{
+	Time now = Simulator::Now();
+	std::vector<InfoSlot> old;
+	old.swap(m_packetInfo);
+	uint32_t live = 0;
+	std::vector<InfoSlot>::const_iterator iter;
+	for(iter = old.begin(); iter != old.end(); iter++)
+		if(iter->used && (m_maxAge.IsZero() || now - iter->stamp <= m_maxAge))
+			live++;
+	uint32_t size = old.size();
+	while(4 * (live + 1) > size)
+		size *= 2;
+	m_packetInfo.resize(size);
+	m_used = 0;
+	for(iter = old.begin(); iter != old.end(); iter++)
+	{
+		if(!iter->used || (!m_maxAge.IsZero() && now - iter->stamp > m_maxAge))
+			continue;
+		m_packetInfo[Probe(iter->pid)] = *iter;
+		m_used++;
+	}
+	NS_LOG_LOGIC("rehashed "<<old.size()<<" slots into "<<size<<", "<<m_used<<" entries kept");
+}
+
+void
+IPCopePacketInfo::SetMaxAge(Time maxAge)
+{
+	m_maxAge = maxAge;
+}
+
+Time
+IPCopePacketInfo::GetMaxAge() const
+{
+	return m_maxAge;
+}
+
+uint32_t
+IPCopePacketInfo::Size() const
+{
+	return m_used;
 }
 
 /*
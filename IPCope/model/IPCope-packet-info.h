@@ -24,12 +24,76 @@
 #include "ns3/mac48-address.h"
 #include "IPCope-neighbor.h"
 #include "IPCope-header.h"
+#include "ns3/nstime.h"
 #include <deque>
 #include <map>
+#include <vector>
+#include <tr1/unordered_map>
 
 namespace ns3{
 namespace ipcope{
 
+#define IPCOPE_MAX_NEIGHBORS 128
+#define IPCOPE_NO_NEIGHBOR IPCOPE_MAX_NEIGHBORS //NeighborId() once every id is taken
+#define IPCOPE_MAX_ALIASES 8192
+
+/*
+ * One bit per neighbor id handed out by IPCopePacketInfo::NeighborId().
+ */
+class NeighborBitmap
+{
+public:
+	NeighborBitmap() { m_words[0] = 0; m_words[1] = 0; }
+	void Set(uint32_t id) { m_words[id >> 6] |= (uint64_t)1 << (id & 63); }
+	void Clear(uint32_t id) { m_words[id >> 6] &= ~((uint64_t)1 << (id & 63)); }
+	bool Test(uint32_t id) const { return (m_words[id >> 6] >> (id & 63)) & 1; }
+	bool IsEmpty() const { return !(m_words[0] | m_words[1]); }
+	//lowest id set, -1 if none
+	int32_t First() const
+	{
+		if(m_words[0])
+			return __builtin_ctzll(m_words[0]);
+		if(m_words[1])
+			return 64 + __builtin_ctzll(m_words[1]);
+		return -1;
+	}
+	//true if every bit set in other is set here too
+	bool Contains(const NeighborBitmap & other) const
+	{
+		return (m_words[0] & other.m_words[0]) == other.m_words[0] && (m_words[1] & other.m_words[1]) == other.m_words[1];
+	}
+	NeighborBitmap & operator&= (const NeighborBitmap & other)
+	{
+		m_words[0] &= other.m_words[0];
+		m_words[1] &= other.m_words[1];
+		return *this;
+	}
+	NeighborBitmap & operator|= (const NeighborBitmap & other)
+	{
+		m_words[0] |= other.m_words[0];
+		m_words[1] |= other.m_words[1];
+		return *this;
+	}
+	static NeighborBitmap All()
+	{
+		NeighborBitmap all;
+		all.m_words[0] = ~(uint64_t)0;
+		all.m_words[1] = ~(uint64_t)0;
+		return all;
+	}
+private:
+	uint64_t m_words[2];
+};
+
+/*
+ * Which neighbors are known to have which packet. Neighbors get dense ids,
+ * and pids map to a NeighborBitmap in an open-addressing table, so a lookup
+ * is one probe plus a bit test. Entries older than the maximum age (zero
+ * means no limit) are dropped when the table is rehashed.
+ *
+ * Ids are released by the owner once their mac no longer names a neighbor,
+ * and handed out again. With every id taken a new mac isn't tracked.
+ */
 class IPCopePacketInfo
 {
 public:
@@ -50,11 +114,51 @@ public:
 	*/
 	//void SetProbability(uint32_t packetId, Neighbor neighbor, double probability);
 	void SetItem(uint32_t packetId, const Mac48Address & mac);
-	bool GetItem(uint32_t packetId, const Mac48Address & mac);
+	bool GetItem(uint32_t packetId, const Mac48Address & mac) const;
 	//void SetItem(IPCopeHeader header, Mac48Address mac);
+	uint32_t NeighborId(const Mac48Address & mac); //IPCOPE_NO_NEIGHBOR if no id is free
+	bool FindNeighborId(const Mac48Address & mac, uint32_t & id) const;
+	bool IsNeighborId(uint32_t id) const; //handed out and not released
+	Mac48Address NeighborMac(uint32_t id) const;
+	uint32_t NeighborCount() const { return m_neighborMacs.size(); } //ids ever handed out, released ones included
+	//the same neighbor under a new mac keeps what it holds
+	void RenameNeighbor(uint32_t id, const Mac48Address & mac);
+	//drops id from every packet and makes it free for another mac
+	void ReleaseNeighbor(uint32_t id);
+	NeighborBitmap Holders(uint32_t packetId) const;
+	//the neighbor we got the packet from, if we did
+	void SetPrevHop(uint32_t packetId, const Mac48Address & mac);
+	bool GetPrevHop(uint32_t packetId, Mac48Address & mac) const;
+	//the pid of a native by its IP source and identification, as reception reports name it
+	void SetAlias(const Ipv4Address & source, uint16_t ipId, uint32_t packetId);
+	bool GetAlias(const Ipv4Address & source, uint16_t ipId, uint32_t & packetId) const;
+	void SetMaxAge(Time maxAge);
+	Time GetMaxAge() const;
+	uint32_t Size() const;
 private:
+	struct InfoSlot
+	{
+		uint32_t pid;
+		NeighborBitmap holders;
+		Time stamp;
+		bool used;
+		bool hasPrevHop;
+		Mac48Address prevHop;
+		InfoSlot() : pid(0), used(false), hasPrevHop(false) {}
+	};
+	int32_t Probe(uint32_t packetId) const;
+	InfoSlot & Insert(uint32_t packetId);
+	void Rehash();
+
 	//std::map<uint32_t, Mac48Address> m_packetInfo;
-	std::map<uint32_t, std::vector<Mac48Address> > m_packetInfo;
+	std::vector<InfoSlot> m_packetInfo; //size is a power of two
+	uint32_t m_used;
+	Time m_maxAge;
+	std::tr1::unordered_map<Mac48Address, uint32_t, Mac48AddressHash> m_neighborIds;
+	std::vector<Mac48Address> m_neighborMacs; //indexed by id
+	std::vector<uint32_t> m_freeIds;
+	std::tr1::unordered_map<uint64_t, uint32_t> m_aliases;
+	std::deque<uint64_t> m_aliasOrder; //oldest first, at most IPCOPE_MAX_ALIASES
 };
 
 }//namespace cope
@@ -19,20 +19,40 @@
 
 #include "IPCope-packet-pool.h"
 #include "ns3/log.h"
+#include "ns3/simulator.h"
 
 NS_LOG_COMPONENT_DEFINE("IPCopePacketPool");
 
 namespace ns3{
 namespace ipcope{
 
-IPCopePacketPool::IPCopePacketPool(){}
+IPCopePacketPool::IPCopePacketPool() :
+	m_oldest(0), m_used(0), m_maxAge(Seconds(0)), m_hits(0), m_misses(0), m_evictions(0)
+{
+	SetCapacity(4096);
+}
+
 IPCopePacketPool::~IPCopePacketPool(){}
 
 void
 IPCopePacketPool::AddToPool(uint32_t pid, Ptr<Packet> pkt)
 {
-	NS_LOG_FUNCTION_NOARGS();
-	m_pool.insert(std::make_pair(pid, pkt->Copy()));
+	NS_LOG_FUNCTION(this<<pid<<m_index.size());
+	Expire();
+	if(m_index.find(pid) != m_index.end())
+		return;
+	if(m_used == m_ring.size())
+		EvictOldest();
+	uint32_t pos = (m_oldest + m_used) % m_ring.size();
+	PoolSlot & slot = m_ring[pos];
+	slot.pid = pid;
+	slot.data.resize(pkt->GetSize());
+	if(slot.data.size())
+		pkt->CopyData(&slot.data[0], slot.data.size());
+	slot.stamp = Simulator::Now();
+	slot.used = true;
+	m_used++;
+	m_index.insert(std::make_pair(pid, pos));
 }
 
 /*
@@ -46,21 +66,125 @@ IPCopePacketPool::AddToPool(const uint32_t pid, const Ptr<Packet> packet, const
 */
 
 bool
-IPCopePacketPool::Find(uint32_t pid, Ptr<Packet> & pkt) const
+IPCopePacketPool::Find(uint32_t pid, Ptr<Packet> & pkt)
 {
 	NS_LOG_FUNCTION_NOARGS();
-	std::tr1::unordered_map<uint32_t, Ptr<Packet> >::const_iterator iter;
-	iter = m_pool.find(pid);
-	if(iter != m_pool.end())
+	const uint8_t *data;
+	uint32_t size;
+	if(!Find(pid, data, size))
+		return false;
+	pkt = Create<Packet>(data, size);
+	return true;
+}
+
+bool
+IPCopePacketPool::Find(uint32_t pid, const uint8_t* & data, uint32_t & size)
+{
+	NS_LOG_FUNCTION_NOARGS();
+	std::tr1::unordered_map<uint32_t, uint32_t>::iterator iter;
+	iter = m_index.find(pid);
+	if(iter != m_index.end())
 	{
-		NS_LOG_FUNCTION(this<<"Found it in pool");
-		pkt = iter->second->Copy();
-		NS_LOG_FUNCTION(this<<"Packet size: "<<pkt->GetSize());
+		PoolSlot & slot = m_ring[iter->second];
+		if(IsExpired(slot))
+		{
+			//leave a hole, Expire() reclaims the slot once it becomes the oldest
+			slot.used = false;
+			m_index.erase(iter);
+			m_evictions++;
+			m_misses++;
+			return false;
+		}
+		NS_LOG_FUNCTION(this<<"Found it in pool"<<slot.data.size());
+		static const uint8_t empty = 0;
+		data = slot.data.size() ? &slot.data[0] : &empty;
+		size = slot.data.size();
+		m_hits++;
 		return true;
 	}
+	m_misses++;
 	return false;
 }
 
+bool
+IPCopePacketPool::IsExpired(const PoolSlot & slot) const
+{
+	return !m_maxAge.IsZero() && Simulator::Now() - slot.stamp > m_maxAge;
+}
+
+void
+IPCopePacketPool::Expire()
+{
+	while(m_used && (!m_ring[m_oldest].used || IsExpired(m_ring[m_oldest])))
+		EvictOldest();
+}
+
+void
+IPCopePacketPool::EvictOldest()
+{
+	NS_ASSERT(m_used);
+	PoolSlot & slot = m_ring[m_oldest];
+	if(slot.used)
+	{
+		NS_LOG_LOGIC("evict "<<slot.pid);
+		m_index.erase(slot.pid);
+		slot.used = false;
+		m_evictions++;
+	}
+	m_oldest = (m_oldest + 1) % m_ring.size();
+	m_used--;
+}
+
+/*
+ * Shrinking keeps the newest entries.
+ */
+void
+IPCopePacketPool::SetCapacity(uint32_t capacity)
+{
+	NS_LOG_FUNCTION(this<<capacity);
+	NS_ASSERT(capacity > 0);
+	std::vector<PoolSlot> ring(capacity);
+	for(uint32_t i = 0; i<capacity; i++)
+		ring[i].used = false;
+	while(m_used > capacity)
+		EvictOldest();
+	uint32_t used = 0;
+	m_index.clear();
+	for(uint32_t i = 0; i<m_used; i++)
+	{
+		PoolSlot & slot = m_ring[(m_oldest + i) % m_ring.size()];
+		if(!slot.used)
+			continue;
+		ring[used].pid = slot.pid;
+		ring[used].data.swap(slot.data);
+		ring[used].stamp = slot.stamp;
+		ring[used].used = true;
+		m_index.insert(std::make_pair(slot.pid, used));
+		used++;
+	}
+	m_ring.swap(ring);
+	m_oldest = 0;
+	m_used = used;
+}
+
+uint32_t
+IPCopePacketPool::GetCapacity() const
+{
+	return m_ring.size();
+}
+
+void
+IPCopePacketPool::SetMaxAge(Time maxAge)
+{
+	m_maxAge = maxAge;
+}
+
+Time
+IPCopePacketPool::GetMaxAge() const
+{
+	return m_maxAge;
+}
+
 /*
  * return -1 if the pid is not found
  * otherwise, return sequence number
@@ -22,6 +22,8 @@
 
 #include <tr1/unordered_map>
 #include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include <vector>
 
 namespace ns3{
 namespace ipcope{
@@ -35,6 +37,15 @@ struct PacketSequenceStruct
 
 typedef struct PacketSequenceStruct PacketSequence;
 */
+/*
+ * Packets we sent or overheard, kept around so coded packets can be decoded.
+ * Entries live in a ring in insertion order with a pid index on top; the
+ * oldest entry is evicted once the ring is full or the entry is older than
+ * the configured maximum age (zero means no age limit).
+ *
+ * Payloads are stored flattened, so Find() can hand out a view of the bytes
+ * without copying. A view stays valid until the next AddToPool or SetCapacity.
+ */
 class IPCopePacketPool
 {
 public:
@@ -42,9 +53,40 @@ public:
 	~IPCopePacketPool();
 	void AddToPool(const uint32_t pid, const Ptr<Packet> pkt);
 	//void AddToPool(const uint32_t pid, const Ptr<Packet> pkt, const uint16_t sequence);
-	bool Find(uint32_t pid, Ptr<Packet> & pkt) const;
+	bool Find(uint32_t pid, Ptr<Packet> & pkt);
+	bool Find(uint32_t pid, const uint8_t* & data, uint32_t & size);
+
+	void SetCapacity(uint32_t capacity);
+	uint32_t GetCapacity() const;
+	void SetMaxAge(Time maxAge);
+	Time GetMaxAge() const;
+	uint32_t Size() const { return m_index.size(); }
+	uint64_t GetHits() const { return m_hits; }
+	uint64_t GetMisses() const { return m_misses; }
+	uint64_t GetEvictions() const { return m_evictions; }
+
 private:
-	std::tr1::unordered_map<uint32_t, Ptr<Packet> > m_pool;
+	struct PoolSlotStruct
+	{
+		uint32_t pid;
+		std::vector<uint8_t> data; //keeps its capacity when the slot is reused
+		Time stamp;
+		bool used;
+	};
+	typedef struct PoolSlotStruct PoolSlot;
+
+	bool IsExpired(const PoolSlot & slot) const;
+	void Expire();
+	void EvictOldest();
+
+	std::vector<PoolSlot> m_ring;
+	uint32_t m_oldest; //ring position of the oldest slot
+	uint32_t m_used; //slots between m_oldest and the write position, holes included
+	std::tr1::unordered_map<uint32_t, uint32_t> m_index; //pid -> ring position
+	Time m_maxAge;
+	uint64_t m_hits;
+	uint64_t m_misses;
+	uint64_t m_evictions;
 	//std::tr1::unordered_map<uint32_t, PacketSequence> m_pool;
 };
 }
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#include "IPCope-pid-tag.h"
+#include "IPCope-hash.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE("IPCopePidTag");
+
+namespace ns3{
+namespace ipcope{
+
+IPCopePidTag::IPCopePidTag():
+	m_pid(0),
+	m_length(0)
+{}
+
+IPCopePidTag::IPCopePidTag(uint32_t pid, uint32_t length):
+	m_pid(pid),
+	m_length(length)
+{}
+
+TypeId
+IPCopePidTag::GetTypeId(void)
+{
+	static TypeId tid = TypeId ("ns3::ipcope::IPCopePidTag")
+		.SetParent<Tag>()
+		.AddConstructor<IPCopePidTag>()
+		;
+	return tid;
+}
+
+TypeId
+IPCopePidTag::GetInstanceTypeId(void) const
+{
+	return GetTypeId();
+}
+
+uint32_t
+IPCopePidTag::GetSerializedSize() const
+{
+	return 8;
+}
+
+void
+IPCopePidTag::Serialize(TagBuffer i) const
+{
+	i.WriteU32(m_pid);
+	i.WriteU32(m_length);
+}
+
+void
+IPCopePidTag::Deserialize(TagBuffer i)
+{
+	m_pid = i.ReadU32();
+	m_length = i.ReadU32();
+}
+
+void
+IPCopePidTag::Print(std::ostream &os) const
+{
+	os<<"pid="<<m_pid<<" length="<<m_length;
+}
+
+void
+IPCopePidTag::SetPacketId(uint32_t pid)
+{
+	m_pid = pid;
+}
+
+uint32_t
+IPCopePidTag::GetPacketId() const
+{
+	return m_pid;
+}
+
+void
+IPCopePidTag::SetLength(uint32_t length)
+{
+	m_length = length;
+}
+
+uint32_t
+IPCopePidTag::GetLength() const
+{
+	return m_length;
+}
+
+uint32_t
+PacketId(Ptr<const Packet> packet)
+{
+	IPCopePidTag tag;
+	if(packet->PeekPacketTag(tag) && tag.GetLength() == packet->GetSize())
+		return tag.GetPacketId();
+	return Hash(packet);
+}
+
+void
+TagPacketId(Ptr<const Packet> packet, uint32_t pid)
+{
+	IPCopePidTag tag;
+	if(packet->PeekPacketTag(tag))
+		return;
+	tag.SetPacketId(pid);
+	tag.SetLength(packet->GetSize());
+	packet->AddPacketTag(tag);
+}
+
+}//namespace ipcope
+}//namespace ns3
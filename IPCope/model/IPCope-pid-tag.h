@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+
+#ifndef COPEPIDTAG_H
+#define COPEPIDTAG_H
+
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+
+namespace ns3{
+namespace ipcope{
+
+/*
+ * Carries a packet's pid along with it, so that hops after the first one
+ * don't have to hash the payload again. The length is the size of the
+ * packet when the tag was attached; a packet whose size has changed since
+ * is hashed as usual.
+ */
+class IPCopePidTag : public Tag
+{
+public:
+	IPCopePidTag();
+	IPCopePidTag(uint32_t pid, uint32_t length);
+	static TypeId GetTypeId (void);
+	virtual TypeId GetInstanceTypeId (void) const;
+	virtual uint32_t GetSerializedSize (void) const;
+	virtual void Serialize (TagBuffer i) const;
+	virtual void Deserialize (TagBuffer i);
+	virtual void Print (std::ostream &os) const;
+
+	void SetPacketId(uint32_t pid);
+	uint32_t GetPacketId() const;
+	void SetLength(uint32_t length);
+	uint32_t GetLength() const;
+private:
+	uint32_t m_pid;
+	uint32_t m_length;
+};
+
+/*
+ * The pid of packet: taken from its IPCopePidTag when that is still valid,
+ * computed with Hash() otherwise.
+ */
+uint32_t PacketId(Ptr<const Packet> packet);
+
+/*
+ * Attaches an IPCopePidTag unless the packet already carries one.
+ */
+void TagPacketId(Ptr<const Packet> packet, uint32_t pid);
+
+}//namespace ipcope
+}//namespace ns3
+
+#endif
@@ -20,8 +20,15 @@
 #include "IPCope-protocol.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/trace-source-accessor.h"
 #include <algorithm>
 #include <stdlib.h>
+#include <math.h>
+#include <limits>
 #include <stdio.h>
 #include <string.h>
 
@@ -60,16 +67,6 @@ IPCopeProtocol::IPCopeProtocol(bool multi, double rttime, double hello) :
 }
 */
 
-IPCopeProtocol::IPCopeProtocol(bool multi, double rttime, double retrytime, double hello) :
-	m_timer(Timer::CANCEL_ON_DESTROY), m_try (Timer::CANCEL_ON_DESTROY), m_helloTimer(Timer::CANCEL_ON_DESTROY)
-{
-	m_rtimeout = MilliSeconds(rttime);
-	m_ttimeout = MilliSeconds(retrytime);
-	m_helloInterval = Seconds(hello);
-	m_mr = multi;
-	Init();
-}
-
 IPCopeProtocol::~IPCopeProtocol()
 {
 }
@@ -78,10 +75,298 @@ TypeId
 IPCopeProtocol::GetTypeId ()
 {
 	static TypeId tid = TypeId ("ns3::ipcope::IPCopeProtocol")
-		.SetParent<Object> ();
+		.SetParent<Object> ()
+		.AddConstructor<IPCopeProtocol> ()
+		.AddAttribute ("RetransmitTimeout", "Retransmit timeout for a nexthop until its acks have been timed",
+						TimeValue(MilliSeconds(25)),
+						MakeTimeAccessor (&IPCopeProtocol::SetRetransmitTimeout,
+										  &IPCopeProtocol::GetRetransmitTimeout),
+						MakeTimeChecker ())
+		.AddAttribute ("MinRto", "Lower bound of the measured retransmit timeouts",
+						TimeValue(MilliSeconds(5)),
+						MakeTimeAccessor (&IPCopeProtocol::SetMinRto,
+										  &IPCopeProtocol::GetMinRto),
+						MakeTimeChecker ())
+		.AddAttribute ("MaxRto", "Upper bound of the retransmit timeouts, backoff included",
+						TimeValue(Seconds(1)),
+						MakeTimeAccessor (&IPCopeProtocol::SetMaxRto,
+										  &IPCopeProtocol::GetMaxRto),
+						MakeTimeChecker ())
+		.AddAttribute ("RetransmitBackoff", "Factor the timeout grows by with every retransmission of a native; 1 for none, 2 for exponential backoff",
+						DoubleValue(1.0),
+						MakeDoubleAccessor (&IPCopeProtocol::m_rtoBackoff),
+						MakeDoubleChecker<double> (1.0))
+		.AddAttribute ("RetryLimit", "How many times a coded native is retransmitted before giving up on its ack",
+						UintegerValue(3),
+						MakeUintegerAccessor (&IPCopeProtocol::m_retryLimit),
+						MakeUintegerChecker<uint8_t> ())
+		.AddAttribute ("TrySendInterval", "How often the mac queues are polled when Polling is on",
+						TimeValue(MilliSeconds(10)),
+						MakeTimeAccessor (&IPCopeProtocol::SetTrySendInterval,
+										  &IPCopeProtocol::GetTrySendInterval),
+						MakeTimeChecker ())
+		.AddAttribute ("HelloInterval", "Time between hellos, plus up to 10 s of jitter",
+						TimeValue(Seconds(10)),
+						MakeTimeAccessor (&IPCopeProtocol::SetHelloInterval,
+										  &IPCopeProtocol::GetHelloInterval),
+						MakeTimeChecker ())
+		.AddAttribute ("QueueMaxSize", "Most packets waiting in the output queue; lowering it drops nothing, packets are refused until the queue is below it",
+						UintegerValue(800),
+						MakeUintegerAccessor (&IPCopeProtocol::SetQueueMaxSize,
+											  &IPCopeProtocol::GetQueueMaxSize),
+						MakeUintegerChecker<uint32_t> (1))
+		.AddAttribute ("MacQueueDepth", "Size the wifi mac queue of each interface is set to; takes effect for interfaces set up afterwards",
+						UintegerValue(10),
+						MakeUintegerAccessor (&IPCopeProtocol::m_macQueueDepth),
+						MakeUintegerChecker<uint32_t> (1))
+		.AddAttribute ("MaxReports", "Most reception report blocks per header",
+						UintegerValue(10),
+						MakeUintegerAccessor (&IPCopeProtocol::m_maxReports),
+						MakeUintegerChecker<uint16_t> ())
+		.AddAttribute ("MaxAcks", "Most ack blocks per header",
+						UintegerValue(16),
+						MakeUintegerAccessor (&IPCopeProtocol::m_maxAcks),
+						MakeUintegerChecker<uint16_t> ())
+		.AddAttribute ("PoolCapacity", "Maximum number of packets kept in the pool for decoding",
+						UintegerValue(4096),
+						MakeUintegerAccessor (&IPCopeProtocol::SetPoolCapacity,
+											  &IPCopeProtocol::GetPoolCapacity),
+						MakeUintegerChecker<uint32_t> (1))
+		.AddAttribute ("PoolMaxAge", "How long a packet is kept in the pool for decoding, zero for no limit",
+						TimeValue(Seconds(10)),
+						MakeTimeAccessor (&IPCopeProtocol::SetPoolMaxAge,
+										  &IPCopeProtocol::GetPoolMaxAge),
+						MakeTimeChecker ())
+		.AddAttribute ("PacketInfoMaxAge", "How long to remember which neighbors have a packet, zero for no limit",
+						TimeValue(Seconds(10)),
+						MakeTimeAccessor (&IPCopeProtocol::SetPacketInfoMaxAge,
+										  &IPCopeProtocol::GetPacketInfoMaxAge),
+						MakeTimeChecker ())
+		.AddAttribute ("Polling", "Also poll the mac queues every retry interval instead of relying on transmit notifications alone",
+						BooleanValue(false),
+						MakeBooleanAccessor (&IPCopeProtocol::SetPolling,
+											 &IPCopeProtocol::GetPolling),
+						MakeBooleanChecker ())
+		.AddAttribute ("LookAhead", "How many packets of each virtual queue, head included, Encode may pick a native from",
+						UintegerValue(1),
+						MakeUintegerAccessor (&IPCopeProtocol::m_lookAhead),
+						MakeUintegerChecker<uint32_t> (1))
+		.AddAttribute ("CodingSearchBudget", "How many candidate natives Encode may examine while searching for the largest coding set",
+						UintegerValue(256),
+						MakeUintegerAccessor (&IPCopeProtocol::m_codingSearchBudget),
+						MakeUintegerChecker<uint32_t> (1))
+		.AddAttribute ("MaxPaddingRatio", "Largest share of a coded packet that may be zero padding for one of its natives; 1 allows any mix of lengths",
+						DoubleValue(1.0),
+						MakeDoubleAccessor (&IPCopeProtocol::m_maxPaddingRatio),
+						MakeDoubleChecker<double> (0.0, 1.0))
+		.AddAttribute ("CodingThreshold", "Least probability every nexthop must have of decoding a coded packet; below 1, natives a nexthop has probably overheard count too",
+						DoubleValue(1.0),
+						MakeDoubleAccessor (&IPCopeProtocol::m_codingThreshold),
+						MakeDoubleChecker<double> (0.0, 1.0))
+		.AddAttribute ("LinkEstimateWeight", "Weight of the newest hello in the link delivery estimates",
+						DoubleValue(0.1),
+						MakeDoubleAccessor (&IPCopeProtocol::SetLinkEstimateWeight,
+											&IPCopeProtocol::GetLinkEstimateWeight),
+						MakeDoubleChecker<double> (0.0, 1.0))
+		.AddAttribute ("InterfacePolicy", "Which idle radio a unicast packet goes out on when its nexthop listens on several channels",
+						EnumValue(INTERFACE_SHORTEST_QUEUE),
+						MakeEnumAccessor (&IPCopeProtocol::m_interfacePolicy),
+						MakeEnumChecker (INTERFACE_FIRST_IDLE, "FirstIdle",
+										 INTERFACE_SHORTEST_QUEUE, "ShortestQueue",
+										 INTERFACE_ETX, "Etx",
+										 INTERFACE_ROUND_ROBIN, "RoundRobin"))
+		.AddAttribute ("PrintPackets", "Dump every packet on the data path to stdout",
+						BooleanValue(false),
+						MakeBooleanAccessor (&IPCopeProtocol::m_printPackets),
+						MakeBooleanChecker ())
+		.AddAttribute ("TracePackets", "Fire PacketTrace for every packet on the data path",
+						BooleanValue(false),
+						MakeBooleanAccessor (&IPCopeProtocol::m_tracePackets),
+						MakeBooleanChecker ())
+		.AddTraceSource ("PacketTrace",
+						"A packet passing a point of the data path, named by the first argument. Needs TracePackets and a build with logging.",
+						MakeTraceSourceAccessor (&IPCopeProtocol::m_packetTrace))
+		.AddTraceSource ("CodedPacket",
+						"A coded packet was built: number of natives, their total length, and the length sent.",
+						MakeTraceSourceAccessor (&IPCopeProtocol::m_codedPacketTrace))
+		;
 	return tid;
 }
 
+void
+IPCopeProtocol::SetRetransmitTimeout(Time timeout)
+{
+	m_rtimeout = timeout;
+	m_acks.SetInitialRto(timeout);
+}
+
+Time
+IPCopeProtocol::GetRetransmitTimeout() const
+{
+	return m_rtimeout;
+}
+
+void
+IPCopeProtocol::SetMinRto(Time rto)
+{
+	m_acks.SetMinRto(rto);
+}
+
+Time
+IPCopeProtocol::GetMinRto() const
+{
+	return m_acks.GetMinRto();
+}
+
+void
+IPCopeProtocol::SetMaxRto(Time rto)
+{
+	m_acks.SetMaxRto(rto);
+}
+
+Time
+IPCopeProtocol::GetMaxRto() const
+{
+	return m_acks.GetMaxRto();
+}
+
+void
+IPCopeProtocol::SetTrySendInterval(Time interval)
+{
+	m_ttimeout = interval;
+	m_try.SetDelay(interval);
+}
+
+Time
+IPCopeProtocol::GetTrySendInterval() const
+{
+	return m_ttimeout;
+}
+
+void
+IPCopeProtocol::SetHelloInterval(Time interval)
+{
+	m_helloInterval = interval;
+	m_helloTimer.SetDelay(interval);
+	//hellos go out up to 10 s late, see HelloTimerExpire
+	m_linkEstimator.SetHelloPeriod(interval + Seconds(10));
+}
+
+Time
+IPCopeProtocol::GetHelloInterval() const
+{
+	return m_helloInterval;
+}
+
+void
+IPCopeProtocol::SetQueueMaxSize(uint32_t size)
+{
+	m_queue.SetMaxSize(size);
+}
+
+uint32_t
+IPCopeProtocol::GetQueueMaxSize() const
+{
+	return m_queue.GetMaxSize();
+}
+
+void
+IPCopeProtocol::SetPoolCapacity(uint32_t capacity)
+{
+	m_pool.SetCapacity(capacity);
+}
+
+uint32_t
+IPCopeProtocol::GetPoolCapacity() const
+{
+	return m_pool.GetCapacity();
+}
+
+void
+IPCopeProtocol::SetPoolMaxAge(Time maxAge)
+{
+	m_pool.SetMaxAge(maxAge);
+}
+
+Time
+IPCopeProtocol::GetPoolMaxAge() const
+{
+	return m_pool.GetMaxAge();
+}
+
+void
+IPCopeProtocol::SetPacketInfoMaxAge(Time maxAge)
+{
+	m_packetInfo.SetMaxAge(maxAge);
+}
+
+Time
+IPCopeProtocol::GetPacketInfoMaxAge() const
+{
+	return m_packetInfo.GetMaxAge();
+}
+
+void
+IPCopeProtocol::SetPolling(bool polling)
+{
+	m_polling = polling;
+	if(m_polling)
+		TrySendSchedule();
+	else
+		m_try.Cancel();
+}
+
+bool
+IPCopeProtocol::GetPolling() const
+{
+	return m_polling;
+}
+
+void
+IPCopeProtocol::TracePacket(const std::string & where, Ptr<const Packet> packet)
+{
+	if(m_tracePackets)
+		m_packetTrace(where, packet);
+	if(m_printPackets)
+	{
+		std::cout<<Simulator::Now().GetSeconds()<<" "<<GetIP()<<" "<<where<<": ";
+		packet->Print(std::cout);
+		std::cout<<std::endl;
+	}
+}
+
+const IPCopePacketPool &
+IPCopeProtocol::GetPacketPool() const
+{
+	return m_pool;
+}
+
+void
+IPCopeProtocol::SetLinkEstimateWeight(double weight)
+{
+	m_linkEstimator.SetWeight(weight);
+}
+
+double
+IPCopeProtocol::GetLinkEstimateWeight() const
+{
+	return m_linkEstimator.GetWeight();
+}
+
+const IPCopeLinkEstimator &
+IPCopeProtocol::GetLinkEstimator() const
+{
+	return m_linkEstimator;
+}
+
+double
+IPCopeProtocol::GetBytesSavedRatio() const
+{
+	if(!m_nativeBytesCoded)
+		return 0;
+	return 1.0 - (double)m_codedBytesSent / m_nativeBytesCoded;
+}
+
 void
 IPCopeProtocol::Init()
 {
@@ -89,13 +374,32 @@ IPCopeProtocol::Init()
 	m_isSending = false;
 	//m_ttimeout = MilliSeconds(m_rtimeout.GetMilliSeconds());
 	m_maxReports = 10;
+	m_maxAcks = 16;
+	m_retryLimit = 3;
+	m_rtoBackoff = 1.0;
+	m_macQueueDepth = 10;
 	m_timer.SetDelay(m_rtimeout);
 	m_timer.SetFunction(&IPCopeProtocol::Retransmit, this);
+	m_acks.SetInitialRto(m_rtimeout);
+	m_polling = false;
+	m_codingIndexVersion = m_neighbors.GetVersion();
+	m_primaryMacsVersion = m_neighbors.GetVersion();
+	m_lookAhead = 1;
+	m_codingSearchBudget = 256;
+	m_maxPaddingRatio = 1.0;
+	m_codingThreshold = 1.0;
+	m_interfacePolicy = INTERFACE_SHORTEST_QUEUE;
+	m_lastIface = 0;
+	m_helloSeq = 0;
+	m_nativeBytesCoded = 0;
+	m_codedBytesSent = 0;
+	m_printPackets = false;
+	m_tracePackets = false;
 	m_try.SetDelay(m_ttimeout);
 	m_try.SetFunction(&IPCopeProtocol::TrySend, this);
-	m_try.Schedule();
 	m_helloTimer.SetDelay(m_helloInterval);
 	m_helloTimer.SetFunction(&IPCopeProtocol::HelloTimerExpire, this);
+	m_linkEstimator.SetHelloPeriod(m_helloInterval + Seconds(10));
 }
 
 bool
@@ -110,7 +414,8 @@ IPCopeProtocol::Enqueue(Ptr<Packet> packet, const Mac48Address& src, const Mac48
 	if(type == HELLO)
 	{
 		entry.SetHello();
-		m_queue.EnqueueFront(entry);
+		if(m_queue.EnqueueFront(entry))
+			Classify(m_queue.FrontHandle(), true);
 	}
 	else
 	{
@@ -120,11 +425,13 @@ IPCopeProtocol::Enqueue(Ptr<Packet> packet, const Mac48Address& src, const Mac48
 		entry.SetIpHeader(ipHeader);
 		entry.SetNexthop();
 		entry.SetIPSrc(ipHeader.GetSource());
-		entry.SetPacketId(Hash(packet));
+		entry.SetPacketId(PacketId(packet));
+		TagPacketId(entry.GetPacket(), entry.GetPacketId());
+		m_packetInfo.SetAlias(ipHeader.GetSource(), ipHeader.GetIdentification(), entry.GetPacketId());
 		entry.SetData();
 		if (m_queue.EnqueueBack(entry))
 		{
-			NS_ASSERT(entry.GetPacketId() == (*(m_queue.LastPosition())).GetPacketId());
+			NS_ASSERT(entry.GetPacketId() == m_queue.Get(m_queue.BackHandle())->GetPacketId());
 			IPCopeNeighbors::NeighborIterator neighborIter;
 			if(!dest.IsBroadcast())
 			{
@@ -135,7 +442,7 @@ IPCopeProtocol::Enqueue(Ptr<Packet> packet, const Mac48Address& src, const Mac48
 					Ipv4Address ip("0.0.0.0");
 					uint16_t channel = m_devices[index]->GetChannelNumber();
 					tmpNeighbor.AddTrinity(ip, dest, channel);
-					tmpNeighbor.AddVirtualQueueEntry(m_queue.LastPosition());
+					tmpNeighbor.AddVirtualQueueEntry(m_queue.BackHandle());
 					if(m_neighbors.AddNeighbor(tmpNeighbor))
 						NS_LOG_FUNCTION(this<<"neighbor added");
 					else
@@ -144,9 +451,11 @@ IPCopeProtocol::Enqueue(Ptr<Packet> packet, const Mac48Address& src, const Mac48
 				else
 				{
 					neighborIter = m_neighbors.At(neighborPos);
-					neighborIter->AddVirtualQueueEntry(m_queue.LastPosition());
+					neighborIter->AddVirtualQueueEntry(m_queue.BackHandle());
+					InvalidateCodingHead(neighborIter->GetMac());
 				}
 			}
+			Classify(m_queue.BackHandle(), false);
 			m_pool.AddToPool(entry.GetPacketId(), packet);
 		}
 	}
@@ -160,34 +469,58 @@ IPCopeProtocol::TrySend()
 	Ipv4Address ip_address = GetIP();
 	NS_LOG_FUNCTION(this<<ip_address<<m_queue.Size()<<m_rtqueue.Size()<<m_try.GetDelay().GetMilliSeconds()<<Simulator::Now().GetSeconds());
 	if(m_isSending)// we don't want to change m_devicesIf when m_isSending = true
-		return TrySendSchedule();
-	m_devicesIf.clear();
-	for(uint32_t i = 0; i<m_devices.size(); i++)
+		return NotifyTxReady(0);
+	//keep handing packets down while some mac queue has room and DoSend gets somewhere
+	bool progress = true;
+	while(progress && m_queue.Size())
 	{
-		Ptr<IPCopeDevice> device = m_devices[i];
-		if (!device->IsQueueFull())
+		std::vector<uint32_t> idle;
+		for(uint32_t i = 0; i<m_devices.size(); i++)
 		{
-			Mac48Address mac_address = Mac48Address::ConvertFrom(device->GetAddress());
-			NS_LOG_FUNCTION("Queue not full: "<<device->GetMacQueueSize()<<" and out queue: "<<m_queue.Size());
-			if (device->GetMacQueueSize() == 0 && m_queue.Size() > 0)
-				NS_LOG_FUNCTION(this<<"Warning: losing bandwidth "<<ip_address<<mac_address);
-			if (device->GetMacQueueSize() == 0 && m_queue.Size() > 1)
-				NS_LOG_FUNCTION(this<<"Warning: losing serious bandwidth "<<ip_address<<mac_address);
-			if (device->GetMacQueueSize() == 0 && m_queue.Size() > 2)
-				NS_LOG_FUNCTION(this<<"Warning: losing very serious bandwidth "<<ip_address<<mac_address);
-			m_devicesIf.push_back(i);
+			Ptr<IPCopeDevice> device = m_devices[i];
+			if (device->GetFreeSlots())
+			{
+				Mac48Address mac_address = Mac48Address::ConvertFrom(device->GetAddress());
+				NS_LOG_FUNCTION("Queue not full: "<<device->GetMacQueueSize()<<" and out queue: "<<m_queue.Size());
+				if (device->GetMacQueueSize() == 0 && m_queue.Size() > 0)
+					NS_LOG_FUNCTION(this<<"Warning: losing bandwidth "<<ip_address<<mac_address);
+				if (device->GetMacQueueSize() == 0 && m_queue.Size() > 1)
+					NS_LOG_FUNCTION(this<<"Warning: losing serious bandwidth "<<ip_address<<mac_address);
+				if (device->GetMacQueueSize() == 0 && m_queue.Size() > 2)
+					NS_LOG_FUNCTION(this<<"Warning: losing very serious bandwidth "<<ip_address<<mac_address);
+				idle.push_back(i);
+			}
+			else
+				ReleaseChosen(i);
+		}
+		if(!idle.size())
+		{
+			NS_LOG_FUNCTION(this<<"all mac queues are full");
+			break;
+		}
+		//one packet for every idle radio per round, so none waits behind another's head
+		progress = false;
+		for(uint32_t i = 0; i<idle.size() && m_queue.Size(); i++)
+		{
+			if(DoSend(idle[i]))
+				progress = true;
 		}
 	}
-	if(m_devicesIf.size())
-	{
-		if(!m_isSending && m_queue.Size())
-			DoSend();
-	}
-	else
-	{
-		NS_LOG_FUNCTION(this<<"all mac queues are full");
-	}
-	TrySendSchedule();
+	if(m_polling)
+		TrySendSchedule();
+}
+
+/*
+ * A device just freed room in its mac queue. Several notifications in the
+ * same instant collapse into one TrySend.
+ */
+void
+IPCopeProtocol::NotifyTxReady(uint32_t index)
+{
+	NS_LOG_FUNCTION(this<<index);
+	if(m_trySendEvent.IsRunning())
+		return;
+	m_trySendEvent = Simulator::ScheduleNow(&IPCopeProtocol::TrySend, this);
 }
 
 void
@@ -223,153 +556,258 @@ IPCopeProtocol::Index(const Mac48Address & src) const
 	return m_devices.size();
 }
 
+/*
+ * Puts a queued entry in the lane of every interface it may go out on: the
+ * one it is bound to and, for unicast data, each one on a channel its
+ * nexthop listens on. Which of them sends it is left to the interface policy.
+ */
+void
+IPCopeProtocol::Classify(const IPCopeQueueHandle & handle, bool front)
+{
+	IPCopeQueueEntry * entry = m_queue.Get(handle);
+	NS_ASSERT(entry);
+	entry->SetIfaceChosen(false);
+	m_queue.AddToLane(entry->GetIface(), handle, front);
+	if(entry->IsHello() || entry->GetDestMac().IsBroadcast())
+		return;
+	int32_t neighborPos = m_neighbors.SearchNeighbor(entry->GetDestMac());
+	if(neighborPos < 0)
+		return;
+	std::set<uint16_t> channels = m_neighbors.At(neighborPos)->GetChannels();
+	for(uint32_t i = 0; i<m_devices.size(); i++)
+	{
+		if(i != entry->GetIface() && channels.count(m_devices[i]->GetChannelNumber()))
+			m_queue.AddToLane(i, handle, front);
+	}
+}
+
+/*
+ * The first entry of the lane of iface that can go out on it. The first
+ * time an idle radio gets to a unicast entry the interface policy picks its
+ * radio, and the entry is moved over to that radio and its nexthop's mac on
+ * that channel; from then on only that radio sends it, unless its mac queue
+ * fills up first (see ReleaseChosen). Entries for other radios are dropped
+ * from the lane.
+ */
+bool
+IPCopeProtocol::PickEntry(uint32_t iface, IPCopeQueueHandle & handle)
+{
+	while(m_queue.LaneFront(iface, handle))
+	{
+		IPCopeQueueEntry * entry = m_queue.Get(handle);
+		int32_t neighborPos = -1;
+		if(!entry->IsHello() && !entry->GetDestMac().IsBroadcast() && !entry->IsIfaceChosen())
+			neighborPos = m_neighbors.SearchNeighbor(entry->GetDestMac());
+		if(neighborPos >= 0)
+		{
+			IPCopeNeighbors::NeighborIterator neighborIter = m_neighbors.At(neighborPos);
+			uint32_t chosen = SelectInterface(iface, *neighborIter);
+			if(chosen < m_devices.size())
+			{
+				entry->SetIfaceChosen(true);
+				entry->SetIface(chosen);
+				entry->SetDestMac(neighborIter->Index(m_devices[chosen]->GetChannelNumber()));
+				//at the front, where ReleaseChosen looks for it
+				if(chosen != iface)
+					m_queue.AddToLane(chosen, handle, true);
+			}
+		}
+		if(entry->GetIface() == iface)
+			return true;
+		m_queue.PopLane(iface);
+	}
+	return false;
+}
+
+/*
+ * Entries other radios handed to iface wait at the front of its lane. Once
+ * its mac queue is full they are classified again, so that an idle radio
+ * can take them instead of them waiting for iface.
+ */
 void
-IPCopeProtocol::DoSend()
+IPCopeProtocol::ReleaseChosen(uint32_t iface)
+{
+	std::vector<IPCopeQueueHandle> handles;
+	IPCopeQueueHandle handle;
+	while(m_queue.LaneFront(iface, handle))
+	{
+		IPCopeQueueEntry * entry = m_queue.Get(handle);
+		if(!entry->IsIfaceChosen() || entry->GetIface() != iface)
+			break;
+		handles.push_back(handle);
+		m_queue.PopLane(iface);
+	}
+	//front to back, first one last
+	for(uint32_t i = handles.size(); i-- > 0; )
+		Classify(handles[i], true);
+}
+
+/*
+ * The radio, among iface and the other radios with room in their mac queue,
+ * that the interface policy sends to neighbor on; m_devices.size() if
+ * neighbor can't be reached from any of them. Ties go to iface.
+ */
+uint32_t
+IPCopeProtocol::SelectInterface(uint32_t iface, const IPCopeNeighbor & neighbor)
+{
+	std::set<uint16_t> channels = neighbor.GetChannels();
+	std::vector<uint32_t> candidates;
+	if(channels.count(m_devices[iface]->GetChannelNumber()))
+		candidates.push_back(iface);
+	if(m_interfacePolicy == INTERFACE_FIRST_IDLE && candidates.size())
+		return iface;
+	for(uint32_t i = 0; i<m_devices.size(); i++)
+	{
+		if(i != iface && m_devices[i]->GetFreeSlots() && channels.count(m_devices[i]->GetChannelNumber()))
+			candidates.push_back(i);
+	}
+	if(!candidates.size())
+		return m_devices.size();
+	uint32_t chosen = candidates[0];
+	if(m_interfacePolicy == INTERFACE_ROUND_ROBIN)
+	{
+		//the first radio after the last one picked
+		for(uint32_t i = 0; i<candidates.size(); i++)
+		{
+			if((candidates[i] + m_devices.size() - m_lastIface - 1) % m_devices.size() < (chosen + m_devices.size() - m_lastIface - 1) % m_devices.size())
+				chosen = candidates[i];
+		}
+		m_lastIface = chosen;
+	}
+	else
+	{
+		double cost = InterfaceCost(chosen, neighbor);
+		for(uint32_t i = 1; i<candidates.size(); i++)
+		{
+			double candidateCost = InterfaceCost(candidates[i], neighbor);
+			if(candidateCost < cost)
+			{
+				chosen = candidates[i];
+				cost = candidateCost;
+			}
+		}
+	}
+	NS_LOG_LOGIC("interface "<<chosen<<" of "<<candidates.size()<<" for "<<neighbor.GetMac());
+	return chosen;
+}
+
+/*
+ * What sending one more packet to neighbor on iface costs under the
+ * interface policy: the packets ahead of it, each weighted by the etx of
+ * the link for INTERFACE_ETX. Links without hello statistics either way
+ * cost infinitely much, so measured ones win.
+ */
+double
+IPCopeProtocol::InterfaceCost(uint32_t iface, const IPCopeNeighbor & neighbor) const
+{
+	double packets = m_devices[iface]->GetMacQueueSize() + 1;
+	if(m_interfacePolicy != INTERFACE_ETX)
+		return packets;
+	Mac48Address local = Mac48Address::ConvertFrom(m_devices[iface]->GetAddress());
+	Mac48Address remote = neighbor.Index(m_devices[iface]->GetChannelNumber());
+	double delivery = m_linkEstimator.GetDelivery(local, remote) * m_linkEstimator.GetInbound(remote);
+	if(delivery <= 0)
+		return std::numeric_limits<double>::infinity();
+	return packets / delivery;
+}
+
+/*
+ * Sends the first entry that can go out on iface, coded with whatever the
+ * neighbors on its channel can decode. Returns false if there was none.
+ */
+bool
+IPCopeProtocol::DoSend(uint32_t iface)
 {
 	Ipv4Address ip_addr = GetIP();
-	NS_LOG_FUNCTION(this<<m_queue.Size()<<m_rtqueue.Size()<<m_ackBlockList.size()<<m_devicesIf.size()<<ip_addr);
+	NS_LOG_FUNCTION(this<<iface<<m_queue.Size()<<m_rtqueue.Size()<<m_acks.PendingSize()<<ip_addr);
 	if(m_queue.Size() > 1)
 		NS_LOG_FUNCTION(this<<"Has chance to encode");
-	m_isSending = true;
-	//IPCopeQueueEntry entry;
 	Ptr<Packet> packet ;//= Create<Packet>();
 	uint32_t outIface;
 	int32_t neighborPos;
 
-	if(!m_queue.Size())
-		NS_FATAL_ERROR("queue size zero");
-
-	IPCopeQueueEntry entry = m_queue.Front();
+	IPCopeQueueHandle handle;
+	if(!PickEntry(iface, handle))
+	{
+		NS_LOG_LOGIC("nothing to send on "<<iface);
+		return false;
+	}
+	m_isSending = true;
+	//Encode may only use the channel of this radio
+	m_devicesIf.assign(1, iface);
+	IPCopeQueueEntry entry = m_queue.Take(handle);
 	//send hello msg
 	if(entry.IsHello())
 	{
 		NS_LOG_LOGIC("Get entry and it's Hello");
-		outIface = entry.GetIface();
-		if(find(m_devicesIf.begin(), m_devicesIf.end(), outIface) == m_devicesIf.end())
-		{
-			NS_LOG_LOGIC("the index we want is not active "<<outIface);
-		}
-		else{
-			m_queue.Dequeue();
-			IPCopeType type(HELLO);
-			packet = entry.GetPacket()->Copy();
-			packet->AddHeader(type);
-			m_devices[outIface]->ForwardDown(packet, entry.GetDestMac(), entry.GetProtocolNumber());
-		}
-		return DoSendEnd();
+		IPCopeType type(HELLO);
+		packet = entry.GetPacket()->Copy();
+		packet->AddHeader(type);
+		m_devices[iface]->ForwardDown(packet, entry.GetDestMac(), entry.GetProtocolNumber());
+		DoSendEnd();
+		return true;
 	}
 	else
 	{
 		IPCopeHeader header;
 		header.SetIp(GetIP());
-		header.AddIdNexthop(entry.GetDestMac(), entry.GetPacketId());
+		NS_ASSERT(entry.Size() <= 0xffff);
+		header.AddIdNexthop(entry.GetDestMac(), entry.GetPacketId(), entry.Size());
 		if(!entry.GetDestMac().IsBroadcast())
 		{
 			neighborPos = m_neighbors.SearchNeighbor(entry.GetDestMac());
 			NS_ASSERT(neighborPos > -1);
-			if (! m_neighbors.At(neighborPos)->RemoveVirtualQueueEntry(entry.GetPacketId()))
-				NS_FATAL_ERROR("Removed failed");
+			//the virtual queue handle went stale with the entry
+			InvalidateCodingHead(m_neighbors.At(neighborPos)->GetMac());
 			if(m_packetInfo.GetItem(entry.GetPacketId(), m_neighbors.At(neighborPos)->GetMac()))
 			{
-				m_queue.Dequeue();
-				return DoSendEnd();
+				DoSendEnd();
+				return true;
 			}
 		}
 
-		m_queue.Dequeue();
-
 		bool encoded = false;
 		if(m_queue.Size() > 0 && !entry.GetDestMac().IsBroadcast())
 			encoded = Encode(entry, packet, header);
 		if(!encoded)
-		{
 			packet = entry.GetPacket()->Copy();
-			outIface = entry.GetIface();
-			if(find(m_devicesIf.begin(), m_devicesIf.end(), outIface) == m_devicesIf.end())
-			{
-				NS_LOG_LOGIC("the index we want is not active "<<outIface);
-				m_queue.EnqueueFront(entry);
-				if(!entry.GetDestMac().IsBroadcast())
-				{
-					neighborPos = m_neighbors.SearchNeighbor(entry.GetDestMac());
-					NS_ASSERT(neighborPos > -1);
-					m_neighbors.At(neighborPos)->AddVirtualQueueEntryFront(m_queue.FirstPosition());
-				}
-				return DoSendEnd();
-			}
-		}
-		else
-			outIface = entry.GetIface();
+		outIface = entry.GetIface();
+		NS_ASSERT(outIface == iface);
 
 		//header.SetLocalPktSeqNum(entry.GetSequence());
 
-		NS_LOG_FUNCTION(this<<"add report: "<<m_recps.size());
-		if(m_recps.size())
-		{
-			if(m_recps.size() > m_neighbors.Size())
-			//if(m_recps.size() > m_maxReports)
-			{
-				for(uint32_t i = 0; i<m_neighbors.Size(); i++)
-				//for(int i = 0; i<m_maxReports; i++)
-				{
-					header.AddRecpReport(m_recps.front());
-					m_recps.pop_front();
-				}
-				//header.SetReportNum(m_maxReports);
-			}
-			else
-			{
-				//uint16_t num = m_recps.size();
-				while(m_recps.size())
-				{
-					header.AddRecpReport(m_recps.front());
-					m_recps.pop_front();
-				}
-				//header.SetReportNum(num);
-
-			}
-		}
+		AddRecpReports(header);
 
-		//Add acks to header
-		NS_LOG_LOGIC("Add "<<m_ackBlockList.size()<<" acks to header");
-		//header.SetAckNum(m_ackBlockList.size());
-		if(m_ackBlockList.size())
+		//number the coded natives per nexthop, the acks name them by it
+		if(encoded)
 		{
-			/*
-			NS_LOG_LOGIC("Ack added "<<m_ackBlockList.size());
-			header.AddAckBlock(m_ackBlockList);
-			m_ackBlockList.clear();
-			*/
-			if(m_ackBlockList.size() > m_neighbors.Size())
+			std::map<Mac48Address, uint32_t> nexthops = header.GetIdNexthops();
+			std::map<Mac48Address, uint32_t>::const_iterator nexthopIter;
+			for(nexthopIter = nexthops.begin(); nexthopIter != nexthops.end(); nexthopIter++)
 			{
-				for(uint32_t i = 0; i<m_neighbors.Size(); i++)
-				{
-					header.AddAckBlock(m_ackBlockList.back());
-					m_ackBlockList.pop_back();
-				}
-			}
-			else
-			{
-				while(m_ackBlockList.size())
-				{
-					header.AddAckBlock(m_ackBlockList.back());
-					m_ackBlockList.pop_back();
-				}
+				neighborPos = m_neighbors.SearchNeighbor(nexthopIter->first);
+				if(neighborPos >= 0)
+					header.SetLinkSeq(nexthopIter->first, m_acks.Assign(NexthopKey(nexthopIter->first), nexthopIter->second));
 			}
 		}
 
+		//one ack block for each neighbor we got something new from
+		NS_LOG_LOGIC("Add "<<m_acks.PendingSize()<<" acks to header");
+		std::vector<AckBlock> acks = m_acks.TakePending(m_maxAcks);
+		for(uint32_t i = 0; i<acks.size(); i++)
+			header.AddAckBlock(acks[i]);
+
 		//forward down
 		packet->AddHeader(header);
 		IPCopeType typeHeader(DATA);
 		packet->AddHeader(typeHeader);
 
 		NS_LOG_FUNCTION(this<<"WifiNetDevice about to send:");
-		packet->Print(std::cout);
-		std::cout<<std::endl;
-		fflush(stdout);
+		IPCOPE_PACKET_TRACE(this, "send", packet);
 
 		m_devices[outIface]->ForwardDown(packet, entry.GetDestMac(), entry.GetProtocolNumber());
 		DoSendEnd();
+		return true;
 	}
 }
 
@@ -377,8 +815,6 @@ void
 IPCopeProtocol::DoSendEnd()
 {
 	NS_LOG_FUNCTION_NOARGS();
-	if(m_timer.GetDelayLeft().IsZero() || !m_timer.IsRunning())
-		m_timer.Schedule();
 	m_isSending = false;
 	//TrySend();
 }
@@ -388,9 +824,7 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 {
 	Ipv4Address ip_address = GetIP();
 	NS_LOG_FUNCTION(this<<m_queue.Size()<<netDevice->GetAddress()<<sender<<receiver<<ip_address);
-	pkt->Print(std::cout);
-	std::cout<<std::endl;
-	fflush(stdout);
+	IPCOPE_PACKET_TRACE(this, "recv", pkt);
 	uint32_t pid;
 	Mac48Address sMac = Mac48Address::ConvertFrom(sender);
 	Mac48Address destMac = Mac48Address::ConvertFrom(receiver);
@@ -409,6 +843,9 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 		IPCopeHello helloHeader;
 		packet->RemoveHeader(helloHeader);
 		NS_LOG_LOGIC("Hello header removed");
+		m_linkEstimator.HelloReceived(sMac, helloHeader.GetSequence());
+		for(uint8_t i = 0; i < helloHeader.GetLength(); i++)
+			m_linkEstimator.SetReports(helloHeader.Get(i).mac, helloHeader.GetLinkReports());
 		m_neighbors.NeighborLearn(helloHeader);
 		TrySend();
 		return;
@@ -426,37 +863,43 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 		channelNumber = m_devices[index]->GetChannelNumber();
 		IPCopeNeighbors::NeighborIterator neighborIter = m_neighbors.SMNeighbors(ipAddr, sMac, channelNumber);
 
-		//update ack
+		//update ack; acks for other nodes name natives by their links' sequence numbers, the reception reports cover those
 		AckBlock ackBlock;
-		std::vector<uint32_t> pids = header.Search(header.GetAckBlocks(), GetIP());
-		std::vector<uint32_t>::const_iterator pidsIter;
-		NS_LOG_FUNCTION(this<<"pids we retrieve from Search: "<<pids.size());
-		for(pidsIter = pids.begin(); pidsIter != pids.end(); pidsIter++)
-		{
-			m_rtqueue.Erase(*pidsIter);
-		}
-
-		//Update packetInfo based on all acks in this header:
-		std::vector<AckBlock> allAcks = header.GetAckBlocks();
-		std::vector<AckBlock>::const_iterator allAckIter;
-		for(allAckIter = allAcks.begin(); allAckIter != allAcks.end(); allAckIter++)
+		if(header.Search(header.GetAckBlocks(), GetIP(), &ackBlock))
 		{
-			m_packetInfo.SetItem(allAckIter->pid, neighborIter->GetMac());
+			Mac48Address nexthop = NexthopKey(neighborIter->GetMac());
+			std::vector<uint32_t> pids = m_acks.Acked(nexthop, ackBlock);
+			NS_LOG_FUNCTION(this<<"pids acked: "<<pids.size());
+			for(uint32_t i = 0; i<pids.size(); i++)
+			{
+				//its deadline stays in the heap and is skipped when it comes up
+				IPCopeQueueEntry * armed = m_rtqueue.Find(pids[i]);
+				if(armed && !armed->GetRetry())
+					m_acks.RttSample(nexthop, Simulator::Now() - armed->GetSendTime());
+				m_rtqueue.Erase(pids[i]);
+				LearnHolder(pids[i], neighborIter->GetMac());
+			}
 		}
 
 		//update packet info based on recp report
 		uint16_t reportNum = header.GetReportNum();
 		if(reportNum)
 		{
-			std::vector<uint32_t> recpReports = header.GetRecpReports();
+			std::vector<RecpReport> recpReports = header.GetRecpReports();
 			NS_ASSERT(reportNum == recpReports.size());
 			NS_LOG_FUNCTION("Assert passed"<<reportNum);
-			std::vector<uint32_t>::const_iterator iter;
+			std::vector<RecpReport>::const_iterator iter;
 			for(iter = recpReports.begin(); iter != recpReports.end(); iter++)
 			{
-				pid = *iter;
-				NS_LOG_FUNCTION(this<<pid);
-				m_packetInfo.SetItem(pid, neighborIter->GetMac());
+				std::vector<uint16_t> ipIds = IPCopeHeader::Expand(*iter);
+				for(uint32_t i = 0; i<ipIds.size(); i++)
+				{
+					//natives we never saw can't be coded with, so an unknown alias is no loss
+					if(!m_packetInfo.GetAlias(iter->address, ipIds[i], pid))
+						continue;
+					NS_LOG_FUNCTION(this<<pid);
+					LearnHolder(pid, neighborIter->GetMac());
+				}
 			}
 		}
 		NS_LOG_FUNCTION("Loop passed");
@@ -471,13 +914,7 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 				int64_t isDecodable = Decode(header, packet);//, sequence);
 				if(isDecodable >= 0 )
 				{
-					packet->Print(std::cout);
-					std::cout<<std::endl;
-					fflush(stdout);
-					packet->PeekHeader(ipHeader);
-					ipHeader.Print(std::cout);
-					std::cout<<std::endl;
-					fflush(stdout);
+					IPCOPE_PACKET_TRACE(this, "decoded", packet);
 					packet->RemoveHeader(ipHeader);
 					ipHeader.SetTtl(64);
 					packet->AddHeader(ipHeader);
@@ -491,22 +928,25 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 						if(header.AmINext(m_macs, pid))
 						{
 							NS_ASSERT((isDecodable - pid) == 0);
-							NS_ASSERT(pid == Hash(packet));
 							NS_LOG_LOGIC("I am next hop");
-							AckBlock ackBlock;
-							ackBlock.address = ipAddr;
-							ackBlock.pid = pid;
-							AddAck(ackBlock);
+							uint32_t nativePid;
+							for(uint32_t i = 0; i<m_macs.size(); i++)
+							{
+								if(header.AmINext(m_macs[i], nativePid))
+									m_acks.Received(ipAddr, header.GetLinkSeq(m_macs[i]));
+							}
+							m_packetInfo.SetPrevHop(pid, sMac);
 							m_devices[index]->ForwardUp(packet, protocol, sMac, destMac, packetType);
 						}
 						else
 						{
 							NS_LOG_LOGIC("I'm not nexthop.");
-							pid = Hash(packet);
+							pid = isDecodable;
 						}
-						m_recps.push_back(pid);
+						m_packetInfo.SetAlias(ipHeader.GetSource(), ipHeader.GetIdentification(), pid);
+						m_recps[ipHeader.GetSource()].insert(ipHeader.GetIdentification());
 						m_pool.AddToPool(pid, packet);
-						m_packetInfo.SetItem(pid, neighborIter->GetMac());
+						LearnHolder(pid, neighborIter->GetMac());
 					}
 				}
 				else{
@@ -526,17 +966,18 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 					if(header.AmINext(m_macs, pid))
 					{
 						NS_LOG_LOGIC("I am next hop");
-						NS_ASSERT(pid == Hash(packet));
+						m_packetInfo.SetPrevHop(pid, sMac);
 						m_devices[index]->ForwardUp(packet, protocol, sMac, destMac, packetType);
 					}
 					else
 					{
 						NS_LOG_LOGIC("No, i'm not");
-						pid = Hash(packet);
+						pid = PacketId(packet);
 					}
-					m_recps.push_back(pid);
+					m_packetInfo.SetAlias(ipHeader.GetSource(), ipHeader.GetIdentification(), pid);
+					m_recps[ipHeader.GetSource()].insert(ipHeader.GetIdentification());
 					m_pool.AddToPool(pid, packet);
-					m_packetInfo.SetItem(pid, neighborIter->GetMac());
+					LearnHolder(pid, neighborIter->GetMac());
 				}
 			}
 		}
@@ -545,6 +986,51 @@ IPCopeProtocol::Recv(Ptr<NetDevice> netDevice, Ptr<const Packet> pkt, uint16_t p
 	TrySend();
 }
 
+/*
+ * Reports what we've received since the last data packet went out, as at most
+ * m_maxReports blocks; each covers one source's IP ids from lastPkt back 32.
+ * What doesn't fit waits for the next header.
+ */
+void
+IPCopeProtocol::AddRecpReports(IPCopeHeader & header)
+{
+	NS_LOG_FUNCTION(this<<"add report: "<<m_recps.size());
+	std::map<Ipv4Address, std::set<uint16_t> >::iterator sourceIter = m_recps.begin();
+	while(sourceIter != m_recps.end() && header.GetReportNum() < m_maxReports)
+	{
+		std::set<uint16_t> & ipIds = sourceIter->second;
+		while(ipIds.size() && header.GetReportNum() < m_maxReports)
+		{
+			//newest id first, then every older one within reach of the bitmap
+			std::set<uint16_t>::iterator iter = ipIds.end();
+			iter--;
+			RecpReport report;
+			report.address = sourceIter->first;
+			report.lastPkt = *iter;
+			report.bitMap = 0;
+			while(true)
+			{
+				uint16_t distance = report.lastPkt - *iter;
+				if(distance > 32)
+					break;
+				if(distance)
+					report.bitMap |= 1u << (distance - 1);
+				if(iter == ipIds.begin())
+				{
+					ipIds.erase(iter);
+					break;
+				}
+				ipIds.erase(iter--);
+			}
+			header.AddRecpReport(report);
+		}
+		if(ipIds.empty())
+			m_recps.erase(sourceIter++);
+		else
+			sourceIter++;
+	}
+}
+
 /*
  * \returns -1 if we need more packets to decode it. 0 if we have every packet. a positive pid if it's decodable and it's decoded.
  */
@@ -556,12 +1042,13 @@ IPCopeProtocol::Decode(const IPCopeHeader & header, Ptr<Packet> & packet)
 
 	std::map<Mac48Address, uint32_t> encodedInfo = header.GetIdNexthops();
 	std::map<Mac48Address, uint32_t>::const_iterator iter;
+	std::vector<XorSource> sources;
 	uint8_t missing = 0;
-	uint8_t found = 0;
+	uint16_t length = 0;
 	for(iter = encodedInfo.begin(); iter != encodedInfo.end(); iter++)
 	{
-		Ptr<Packet> foundPkt;
-		if(!m_pool.Find(iter->second, foundPkt))
+		XorSource found;
+		if(!m_pool.Find(iter->second, found.data, found.size))
 		{
 			if(++missing > 1)
 			{
@@ -569,47 +1056,231 @@ IPCopeProtocol::Decode(const IPCopeHeader & header, Ptr<Packet> & packet)
 				return -1;
 			}
 			pid = iter->second;
+			length = header.GetNativeLength(iter->first);
 		}
-		else //find this pid, XOR it with the coded mess
+		else
 		{
-			NS_LOG_FUNCTION(this<<"found in pool: "<<iter->second<<foundPkt->GetSize());
-			if(++found < encodedInfo.size())
-				packet = XOR(foundPkt, packet);
-			else
-				break;
+			NS_LOG_FUNCTION(this<<"found in pool: "<<iter->second<<found.size);
+			sources.push_back(found);
 		}
 	}
-	NS_LOG_FUNCTION(this<<"after loop"<<(uint16_t)missing<<(uint16_t)found<<encodedInfo.size());
-	if(missing == 0 && found  == encodedInfo.size())
+	NS_LOG_FUNCTION(this<<"after loop"<<(uint16_t)missing<<sources.size()<<encodedInfo.size());
+	if(missing == 0)
 	{
 		NS_LOG_FUNCTION(this<<"Decoding failed: all pkts found");
 		return -2;
 	}
-	else
+	//strip every known native from the coded packet in a single sweep, reading them in place from the pool
+	packet = XorMany(packet, sources);
+	if(packet->GetSize() < length)
+	{
+		NS_LOG_FUNCTION(this<<"Decoding failed: coded payload shorter than the native"<<packet->GetSize()<<length);
+		return -1;
+	}
+	packet->RemoveAtEnd(packet->GetSize() - length);
+	//the coded packet was built from raw bytes, so the native's tag has to be put back
+	TagPacketId(packet, pid);
+	NS_LOG_FUNCTION(this<<"Decoding succeeded."<<pid);
+	return pid;
+}
+
+void
+IPCopeProtocol::LearnHolder(uint32_t pid, const Mac48Address & mac)
+{
+	SyncPrimaryMacs();
+	m_packetInfo.SetItem(pid, mac);
+	uint32_t id;
+	if(m_packetInfo.FindNeighborId(mac, id))
+		m_codingIndex.AddHolder(pid, id);
+}
+
+void
+IPCopeProtocol::InvalidateCodingHead(const Mac48Address & mac)
+{
+	SyncPrimaryMacs();
+	uint32_t id;
+	if(m_packetInfo.FindNeighborId(mac, id))
+		m_codingIndex.Invalidate(id);
+}
+
+/*
+ * Neighbor ids and ack links are keyed by primary mac. Once a mac no longer
+ * is one, its ack link follows the neighbor to its new primary mac, and so
+ * does its id if that has none yet; the id is released otherwise. Runs
+ * before either is looked up whenever the neighbors changed since the last
+ * time.
+ */
+void
+IPCopeProtocol::SyncPrimaryMacs()
+{
+	if(m_neighbors.GetVersion() == m_primaryMacsVersion)
+		return;
+	m_primaryMacsVersion = m_neighbors.GetVersion();
+	std::vector<Mac48Address> nexthops = m_acks.GetNexthops();
+	for(uint32_t i = 0; i<nexthops.size(); i++)
 	{
-		NS_LOG_FUNCTION(this<<"Decoding succeeded."<<pid);
-		return pid;
+		int32_t neighborPos = m_neighbors.SearchNeighbor(nexthops[i]);
+		if(neighborPos >= 0)
+			m_acks.Rekey(nexthops[i], m_neighbors.At(neighborPos)->GetMac());
+	}
+	for(uint32_t id = 0; id < m_packetInfo.NeighborCount(); id++)
+	{
+		if(!m_packetInfo.IsNeighborId(id))
+			continue;
+		Mac48Address mac = m_packetInfo.NeighborMac(id);
+		int32_t neighborPos = m_neighbors.SearchNeighbor(mac);
+		if(neighborPos >= 0 && m_neighbors.At(neighborPos)->GetMac() == mac)
+			continue;
+		uint32_t other;
+		if(neighborPos >= 0 && !m_packetInfo.FindNeighborId(m_neighbors.At(neighborPos)->GetMac(), other))
+		{
+			NS_LOG_LOGIC("neighbor id "<<id<<" moves from "<<mac<<" to "<<m_neighbors.At(neighborPos)->GetMac());
+			m_packetInfo.RenameNeighbor(id, m_neighbors.At(neighborPos)->GetMac());
+		}
+		else
+		{
+			NS_LOG_LOGIC("neighbor id "<<id<<" of "<<mac<<" released");
+			m_codingIndex.Forget(id);
+			m_packetInfo.ReleaseNeighbor(id);
+		}
 	}
 }
 
+void
+IPCopeProtocol::RefreshCodingIndex()
+{
+	SyncPrimaryMacs();
+	if(m_neighbors.GetVersion() != m_codingIndexVersion)
+	{
+		//neighbors came, went or merged, so any id may have a new head
+		m_codingIndex.InvalidateAll();
+		m_codingIndexVersion = m_neighbors.GetVersion();
+	}
+	NeighborBitmap dirty = m_codingIndex.Dirty();
+	for(int32_t id = dirty.First(); id >= 0; id = dirty.First())
+	{
+		dirty.Clear(id);
+		IPCopeQueueEntry* head = 0;
+		if(m_packetInfo.IsNeighborId(id))
+		{
+			Mac48Address mac = m_packetInfo.NeighborMac(id);
+			int32_t neighborPos = m_neighbors.SearchNeighbor(mac);
+			if(neighborPos >= 0 && m_neighbors.At(neighborPos)->GetMac() == mac)
+				head = m_neighbors.At(neighborPos)->GetVirtualQueueEntry(m_queue);
+		}
+		if(head)
+			m_codingIndex.SetHead(id, head->GetPacketId(), m_packetInfo.Holders(head->GetPacketId()));
+		else
+			m_codingIndex.ClearHead(id);
+	}
+}
+
+/*
+ * Moves every entry of m_rtqueue whose deadline has passed back to the
+ * front of the output queue, earliest deadline first.
+ */
 void
 IPCopeProtocol::Retransmit()
 {
-	if(!m_rtqueue.Size())
+	NS_LOG_FUNCTION(this<<m_rtqueue.Size()<<m_rtDeadlines.size());
+	Time now = Simulator::Now();
+	std::vector<IPCopeQueueEntry> expired;
+	while(!m_rtDeadlines.empty() && m_rtDeadlines.top().deadline <= now)
+	{
+		RetransmitDeadline due = m_rtDeadlines.top();
+		m_rtDeadlines.pop();
+		IPCopeQueueEntry * armed = m_rtqueue.Find(due.pid);
+		if(!armed || armed->GetDeadline() != due.deadline)
+			continue;
+		expired.push_back(*armed);
+		m_rtqueue.Erase(due.pid);
+	}
+	//pushed to the front last to first, so the earliest goes out first
+	for(uint32_t i = expired.size(); i-- > 0; )
+	{
+		IPCopeQueueEntry & entry = expired[i];
+		entry.Retry();
+		if (m_queue.EnqueueFront(entry))
+		{
+			NS_ASSERT(m_queue.Get(m_queue.FrontHandle())->GetPacketId() == entry.GetPacketId());
+			int32_t neighborPos = m_neighbors.SearchNeighbor(entry.GetDestMac());
+			NS_ASSERT(neighborPos >= 0);
+			IPCopeNeighbors::NeighborIterator neighborIter = m_neighbors.At(neighborPos);
+			neighborIter->AddVirtualQueueEntryFront(m_queue.FrontHandle());
+			InvalidateCodingHead(neighborIter->GetMac());
+			Classify(m_queue.FrontHandle(), true);
+		}
+	}
+	ScheduleRetransmit();
+	if(expired.size())
+		TrySend();
+}
+
+/*
+ * The key m_acks knows a nexthop by: its neighbor's primary mac.
+ */
+Mac48Address
+IPCopeProtocol::NexthopKey(const Mac48Address & destMac)
+{
+	SyncPrimaryMacs();
+	int32_t neighborPos = m_neighbors.SearchNeighbor(destMac);
+	if(neighborPos < 0)
+		return destMac;
+	return m_neighbors.At(neighborPos)->GetMac();
+}
+
+/*
+ * Keeps a native that is about to go out coded until it's acked, or until
+ * its nexthop's retransmit timeout, grown by the backoff for every earlier
+ * retransmission, runs out.
+ */
+void
+IPCopeProtocol::ArmRetransmit(IPCopeQueueEntry entry)
+{
+	if(entry.HitMax(m_retryLimit))
 		return;
-	NS_LOG_FUNCTION(this<<m_rtqueue.Size());
-	IPCopeQueueEntry entry = m_rtqueue.Dequeue();
-	entry.Retry();
-	if (m_queue.EnqueueFront(entry))
+	Time now = Simulator::Now();
+	Time rto = m_acks.GetRto(NexthopKey(entry.GetDestMac()));
+	if(entry.GetRetry() && m_rtoBackoff > 1.0)
 	{
-		NS_ASSERT((*(m_queue.FirstPosition())).GetPacketId() == entry.GetPacketId());
-		int32_t neighborPos = m_neighbors.SearchNeighbor(entry.GetDestMac());
-		NS_ASSERT(neighborPos >= 0);
-		IPCopeNeighbors::NeighborIterator neighborIter = m_neighbors.At(neighborPos);
-		neighborIter->AddVirtualQueueEntryFront(m_queue.FirstPosition());
+		rto = Seconds(rto.GetSeconds() * pow(m_rtoBackoff, entry.GetRetry()));
+		if(rto > m_acks.GetMaxRto())
+			rto = m_acks.GetMaxRto();
 	}
-	m_timer.Schedule();
-	TrySend();
+	entry.SetSendTime(now);
+	entry.SetDeadline(now + rto);
+	if(!m_rtqueue.EnqueueBack(entry))
+		return;
+	RetransmitDeadline due;
+	due.deadline = entry.GetDeadline();
+	due.pid = entry.GetPacketId();
+	m_rtDeadlines.push(due);
+	ScheduleRetransmit();
+}
+
+/*
+ * Points m_timer at the earliest deadline, dropping the stale ones on top.
+ */
+void
+IPCopeProtocol::ScheduleRetransmit()
+{
+	while(!m_rtDeadlines.empty())
+	{
+		IPCopeQueueEntry * armed = m_rtqueue.Find(m_rtDeadlines.top().pid);
+		if(armed && armed->GetDeadline() == m_rtDeadlines.top().deadline)
+			break;
+		m_rtDeadlines.pop();
+	}
+	if(m_rtDeadlines.empty())
+	{
+		m_timer.Cancel();
+		return;
+	}
+	Time delay = m_rtDeadlines.top().deadline - Simulator::Now();
+	if(m_timer.IsRunning() && m_timer.GetDelayLeft() <= delay)
+		return;
+	m_timer.Cancel();
+	m_timer.Schedule(delay);
 }
 
 /*
@@ -634,132 +1305,161 @@ IPCopeProtocol::Encode(IPCopeQueueEntry & entry, Ptr<Packet> & packet, IPCopeHea
 	Ipv4Address ip_address = GetIP();
 	NS_LOG_FUNCTION(this<<m_queue.Size()<<ip_address);
 	IPCopeQueueEntry newEntry = entry;
-	std::set<Mac48Address> m_nexthops;
-	std::set<uint32_t> m_natives;
-	std::set<uint16_t> channels;
 	IPCopeNeighbors::NeighborIterator neighborIter;
-	bool isEncoded = false;
-	IPCopeQueueEntry* virtualQueueEntry;
 	uint32_t packetId = entry.GetPacketId();
-	bool capable = true;
-	//uint16_t channel;
+	std::vector<Ptr<const Packet> > natives; //XORed once the coding set is complete
 
 	int32_t neighborPos = m_neighbors.SearchNeighbor(entry.GetDestMac());
-	std::cout<<(*m_neighbors.At(neighborPos));
-	std::cout<<std::endl;
-	fflush(stdout);
-
 	if(neighborPos < 0)
 		return false;
+	NS_LOG_LOGIC("coding for "<<(*m_neighbors.At(neighborPos)));
 
 	neighborIter = m_neighbors.At(neighborPos);
+	RefreshCodingIndex();
 	if(m_packetInfo.GetItem(packetId, neighborIter->GetMac()))
 		return false;
-	m_nexthops.insert(neighborIter->GetMac());
-	m_natives.insert(packetId);
-	channels = neighborIter->GetChannels();
-
-	uint32_t neighborSize = m_neighbors.Size();
-	for(uint32_t i= 0; i<neighborSize; i++)
+	natives.push_back(entry.GetPacket());
+	uint32_t nexthopId = m_packetInfo.NeighborId(neighborIter->GetMac());
+	if(nexthopId == IPCOPE_NO_NEIGHBOR)
+		return false;
+	IPCopeCodingSet state;
+	state.nexthops.Set(nexthopId);
+	state.holders = m_packetInfo.Holders(packetId);
+	state.channels = neighborIter->GetChannels();
+	state.minLength = entry.Size();
+	state.maxLength = entry.Size();
+	state.bytes = entry.Size();
+	//below a threshold of one, nexthops may also be trusted to have overheard a native
+	bool guess = m_codingThreshold < 1;
+	IPCopeCodingOption first;
+	first.neighborPos = neighborPos;
+	first.id = nexthopId;
+	first.depth = 0;
+	first.entry = &entry;
+	first.holders = state.holders;
+	first.length = entry.Size();
+	first.hasPrevHop = m_packetInfo.GetPrevHop(packetId, first.prevHop);
+	if(guess)
 	{
-		neighborIter = m_neighbors.At(i);
-		capable = true;
-		NS_LOG_FUNCTION(this<<"Actually in the loop");
-		std::set<Ipv4Address>::const_iterator iter;
-		if(m_nexthops.find(neighborIter->GetMac()) != m_nexthops.end())
-			continue;
+		state.members.push_back(&first);
+		state.decode.push_back(1.0);
+	}
 
-		virtualQueueEntry = neighborIter->GetVirtualQueueEntry();
-		if(!virtualQueueEntry)
-			continue;
-		if(m_packetInfo.GetItem(virtualQueueEntry->GetPacketId(), neighborIter->GetMac()))
+	//only neighbors which have every native are worth a look; the index only knows about heads
+	NeighborBitmap candidates = m_codingIndex.Pending();
+	if(!guess)
+		candidates &= state.holders;
+	if(m_lookAhead <= 1 && !guess)
+		candidates &= m_codingIndex.Knows(nexthopId);
+	candidates.Clear(nexthopId);
+	//bucketed by how far their length class is from the first native's, so close matches come first
+	std::vector<IPCopeCodingOption> buckets[IPCOPE_LENGTH_CLASSES];
+	uint32_t lengthClass = IPCopeCodingSearch::LengthClass(entry.Size());
+	std::vector<IPCopeQueueEntry*> entries;
+	for(int32_t id = candidates.First(); id >= 0; id = candidates.First())
+	{
+		candidates.Clear(id);
+		Mac48Address mac = m_packetInfo.NeighborMac(id);
+		neighborPos = m_neighbors.SearchNeighbor(mac);
+		if(neighborPos < 0 || m_neighbors.At(neighborPos)->GetMac() != mac)
 			continue;
-		NS_LOG_DEBUG("packet id retrived through virtual queue entry: "<<virtualQueueEntry->GetPacketId());
-
-		if(virtualQueueEntry->GetDestMac().IsBroadcast())
-			NS_FATAL_ERROR("virtual queue entry from neighbor shouldn't have broadcast addr as dest");
-
-		std::set<Mac48Address>::const_iterator iterNexthops;
-		for(iterNexthops = m_nexthops.begin(); iterNexthops != m_nexthops.end(); iterNexthops++)
+		entries.clear();
+		m_neighbors.At(neighborPos)->PeekVirtualQueue(m_queue, m_lookAhead, entries);
+		if(entries.empty() || entries[0]->GetPacketId() != m_codingIndex.GetHead(id))
 		{
-			NS_LOG_FUNCTION(this<<"In the first inner loop to check if nexthops have the new pkt");
-			if(!m_packetInfo.GetItem(virtualQueueEntry->GetPacketId(), *iterNexthops))
-			{
-				capable = false;
-				break;
-			}
+			//the index missed a change; the checks below don't rely on it
+			m_codingIndex.Invalidate(id);
 		}
-		if(!capable)
-			continue;
-		std::set<uint32_t>::iterator id_iter;
-		for(id_iter = m_natives.begin(); id_iter !=m_natives.end(); id_iter++)
+		for(uint32_t depth = 0; depth < entries.size(); depth++)
 		{
-			NS_LOG_FUNCTION(this<<"In the second inner loop to check if this neighbor has all natives");
-			if(!m_packetInfo.GetItem(*id_iter, neighborIter->GetMac()))
-			{
-				capable = false;
-				break;
-			}
+			if(entries[depth]->GetDestMac().IsBroadcast())
+				NS_FATAL_ERROR("virtual queue entry from neighbor shouldn't have broadcast addr as dest");
+			IPCopeCodingOption option;
+			option.neighborPos = neighborPos;
+			option.id = id;
+			option.depth = depth;
+			option.entry = entries[depth];
+			option.holders = m_packetInfo.Holders(entries[depth]->GetPacketId());
+			option.length = entries[depth]->Size();
+			//no use if the neighbor has it already or the first nexthop can't decode it
+			if(option.holders.Test(id) || (!guess && !option.holders.Test(nexthopId)))
+				continue;
+			option.hasPrevHop = guess && m_packetInfo.GetPrevHop(entries[depth]->GetPacketId(), option.prevHop);
+			option.channels = m_neighbors.At(neighborPos)->GetChannels();
+			uint32_t optionClass = IPCopeCodingSearch::LengthClass(option.length);
+			buckets[optionClass > lengthClass ? optionClass - lengthClass : lengthClass - optionClass].push_back(option);
 		}
-		if(!capable)
-			continue;
+	}
+	std::vector<IPCopeCodingOption> options;
+	for(uint32_t i = 0; i < IPCOPE_LENGTH_CLASSES; i++)
+		options.insert(options.end(), buckets[i].begin(), buckets[i].end());
+
+	IPCopeCodingSearch search(m_packetInfo, m_linkEstimator);
+	search.SetMaxPaddingRatio(m_maxPaddingRatio);
+	search.SetCodingThreshold(m_codingThreshold);
+	std::set<uint16_t> freeChannels;
+	for(uint32_t i = 0; i < m_devicesIf.size(); i++)
+	{
+		uint16_t channel = m_devices[m_devicesIf[i]]->GetChannelNumber();
+		if(Index(channel) == m_devicesIf[i])
+			freeChannels.insert(channel);
+	}
+	search.SetFreeChannels(freeChannels);
+	std::vector<uint32_t> best;
+	uint32_t budget = m_codingSearchBudget;
+	search.Search(options, state, best, budget);
+	NS_LOG_LOGIC(options.size()<<" options, coding "<<best.size()<<" of them, budget left "<<budget);
 
-		NS_LOG_FUNCTION("Successfully passed first two tests");
-		//examine channel intersection
-		std::set<uint16_t> tempChannel = neighborIter->GetChannels();
+	for(uint32_t i = 0; i < best.size(); i++)
+	{
+		const IPCopeCodingOption & option = options[best[i]];
+		neighborIter = m_neighbors.At(option.neighborPos);
 		std::set<uint16_t> intersection;
-		set_intersection(channels.begin(), channels.end(), tempChannel.begin(), tempChannel.end(), std::insert_iterator<std::set<uint16_t> > (intersection, intersection.begin()));
-		if(!intersection.size())
-		{
-			NS_LOG_FUNCTION(this<<"Can't encode due to channel");
-			capable = false;
-		}
-		else{
-			channels = intersection;
-		}
-
-		//newEntry.SetChannel(*(intersection.begin()));
+		bool capable = search.Channels(state.channels, option, intersection);
+		NS_ASSERT(capable);
+		state.channels = intersection;
+		state.bytes += option.length;
+		state.maxLength = std::max(state.maxLength, option.length);
 		std::set<uint16_t>::const_iterator channel_iter;
-		bool hasInterface = false;
-		for(channel_iter = channels.begin(); channel_iter != channels.end(); channel_iter++)
+		for(channel_iter = state.channels.begin(); channel_iter != state.channels.end(); channel_iter++)
 		{
 			uint32_t index = Index(*channel_iter);
 			if(find(m_devicesIf.begin(), m_devicesIf.end(), index) != m_devicesIf.end())
 			{
-				hasInterface = true;
 				newEntry.SetIface(index);
 				newEntry.SetDestMac(neighborIter->Index(*channel_iter));
 			}
 		}
-		if(!hasInterface)
-			capable = false;
-		if(!capable)
-			continue;
 
-		NS_LOG_DEBUG("Before enter XOR:");
-
-		newEntry.SetPacket(XOR(entry.GetPacket(), (*virtualQueueEntry).GetPacket()));
-
-		m_nexthops.insert(neighborIter->GetMac());
-		m_natives.insert(virtualQueueEntry->GetPacketId());
-		IPCopeQueueEntry rte = *virtualQueueEntry;
-		if(!rte.HitMax())
-			m_rtqueue.EnqueueBack(rte);
-		isEncoded = true;
-		NS_LOG_FUNCTION(this<<"ENCODED!!"<<Simulator::Now().GetSeconds());
-		if (!copeHeader.AddIdNexthop(virtualQueueEntry->GetDestMac(), virtualQueueEntry->GetPacketId()))
-			NS_FATAL_ERROR("IdNexthop not added "<<virtualQueueEntry->GetDestMac());
-		if (! m_queue.Erase(virtualQueueEntry->GetPacketId()))
+		IPCopeQueueEntry rte = *option.entry;
+		//named by its mac on the channel the coded packet goes out on
+		rte.SetIface(newEntry.GetIface());
+		rte.SetDestMac(neighborIter->Index(m_devices[newEntry.GetIface()]->GetChannelNumber()));
+		natives.push_back(rte.GetPacket());
+		ArmRetransmit(rte);
+		NS_LOG_FUNCTION(this<<"ENCODED!!"<<Simulator::Now().GetSeconds()<<option.depth);
+		NS_ASSERT(rte.Size() <= 0xffff);
+		if (!copeHeader.AddIdNexthop(rte.GetDestMac(), rte.GetPacketId(), rte.Size()))
+			NS_FATAL_ERROR("IdNexthop not added "<<rte.GetDestMac());
+		if (! m_queue.Erase(rte.GetPacketId()))
 			NS_FATAL_ERROR("Failed to erase from queue");
-		neighborIter->RemoveVirtualQueueEntry();
-
-		capable = true;
+		//handles further back go stale and are dropped once they reach the front
+		if(option.depth == 0)
+			neighborIter->RemoveVirtualQueueEntry();
+		m_codingIndex.Invalidate(option.id);
+	}
+	bool isEncoded = !best.empty();
+	if(isEncoded)
+	{
+		newEntry.SetPacket(XorMany(natives));
+		m_nativeBytesCoded += state.bytes;
+		m_codedBytesSent += state.maxLength;
+		m_codedPacketTrace(natives.size(), state.bytes, state.maxLength);
 	}
 	packet = newEntry.GetPacket()->Copy();
-	
+
 	if(isEncoded)
-		if(!entry.HitMax())
-			m_rtqueue.EnqueueBack(entry);
+		ArmRetransmit(entry);
 	entry = newEntry;
 	return isEncoded;
 }
@@ -794,46 +1494,71 @@ IPCopeProtocol::AddNeighborNIC(Mac48Address mac, uint16_t channel)
 Ptr<Packet>
 IPCopeProtocol::XOR(Ptr<const Packet> p1, Ptr<const Packet> p2)
 {
-	NS_LOG_FUNCTION(this<<p1->GetSize()<<p2->GetSize());
-	uint32_t len1 = p1->GetSize(), len2 = p2->GetSize();
-	uint32_t big, small;
-
-	big = (len1 > len2) ? len1 : len2;
-	small = (len1 > len2) ? len2: len1;
-	
-	uint8_t *buffer = new uint8_t[big];
-	uint8_t *buf1 = new uint8_t[len1];
-	uint8_t *buf2 = new uint8_t[len2];
-
-	memset(buffer, 0, big);
-	memset(buf1, 0, len1);
-	memset(buf2, 0, len2);
+	std::vector<Ptr<const Packet> > packets;
+	packets.push_back(p1);
+	packets.push_back(p2);
+	return XorMany(packets);
+}
 
-	NS_LOG_DEBUG("Before copy");
-	p1->CopyData(buf1, len1);
-	p2->CopyData(buf2, len2);
+/*
+ * XOR all packets together in one pass: the longest one is copied straight
+ * into the result buffer, every other one is read once and folded into it.
+ * The result is exactly as long as the longest packet; receivers cut a
+ * decoded native back to the length carried in IPCopeHeader.
+ */
+Ptr<Packet>
+IPCopeProtocol::XorMany(const std::vector<Ptr<const Packet> > & packets)
+{
+	NS_LOG_FUNCTION(this<<packets.size());
+	NS_ASSERT(packets.size());
+	uint32_t longest = 0;
+	for(uint32_t i = 1; i<packets.size(); i++)
+	{
+		if(packets[i]->GetSize() > packets[longest]->GetSize())
+			longest = i;
+	}
+	uint32_t big = packets[longest]->GetSize();
 
-	for(uint32_t i = 0; i<small; i++)
-		buffer[i] = buf1[i]^buf2[i];
-	for(uint32_t i = small; i<big; i++)
+	uint8_t *buffer = m_codeBuffer.Get(big);
+	packets[longest]->CopyData(buffer, big);
+	for(uint32_t i = 0; i<packets.size(); i++)
 	{
-		if(len1 > len2)
-			buffer[i] = buf1[i]^0;
-		else 
-			buffer[i] = buf2[i]^0;
+		if(i == longest)
+			continue;
+		uint32_t len = packets[i]->GetSize();
+		uint8_t *operand = m_operandBuffer.Get(len);
+		packets[i]->CopyData(operand, len);
+		XorInto(buffer, operand, len);
 	}
-	NS_LOG_DEBUG("Before XOR");
-	uint32_t true_len= big-1;
-	while(!buffer[true_len])
-		true_len--;
-	Ptr<Packet> packet = Create<Packet>(buffer, true_len+1);
-	delete [] buffer;
-	delete [] buf1;
-	delete [] buf2;
+
+	Ptr<Packet> packet = Create<Packet>(buffer, big);
 	NS_LOG_FUNCTION(this<<packet->GetSize());
 	return packet;
 }
 
+/*
+ * Same as above for a packet and a set of flat payloads, which are XORed
+ * straight from where they live without being copied first.
+ */
+Ptr<Packet>
+IPCopeProtocol::XorMany(Ptr<const Packet> packet, const std::vector<XorSource> & sources)
+{
+	NS_LOG_FUNCTION(this<<packet->GetSize()<<sources.size());
+	uint32_t size = packet->GetSize();
+	uint32_t big = size;
+	std::vector<XorSource>::const_iterator iter;
+	for(iter = sources.begin(); iter != sources.end(); iter++)
+		big = std::max(big, iter->size);
+
+	uint8_t *buffer = m_codeBuffer.Get(big);
+	packet->CopyData(buffer, size);
+	memset(buffer + size, 0, big - size);
+	for(iter = sources.begin(); iter != sources.end(); iter++)
+		XorInto(buffer, iter->data, iter->size);
+
+	return Create<Packet>(buffer, big);
+}
+
 std::vector<Ptr<IPCopeDevice> >
 IPCopeProtocol::GetDevices() const
 {
@@ -932,38 +1657,6 @@ IPCopeProtocol::GetIP() const
 
 }
 
-/*
-void
-IPCopeProtocol::AddAck(AckBlock ack)
-{
-	bool found = false;
-	std::vector<AckBlock>::iterator iter;
-	for(iter = m_ackBlockList.begin(); iter != m_ackBlockList.end(); iter++)
-	{
-		if(iter->address == ack.address)
-		{
-			NS_ASSERT(!found);
-			found = true;
-			if(iter->lastAck <= ack.lastAck)
-			{
-				iter->lastAck = ack.lastAck;
-				iter->ackMap = ack.ackMap;
-			}
-		}
-	}
-	if(!found)
-		m_ackBlockList.push_back(ack);
-}
-*/
-
-void
-IPCopeProtocol::AddAck(AckBlock ack)
-{
-	NS_LOG_FUNCTION(this<<m_ackBlockList.size());
-	m_ackBlockList.push_back(ack);
-	NS_LOG_FUNCTION(this<<m_ackBlockList.size());
-}
-
 void
 IPCopeProtocol::SetNode(Ptr<Node> node)
 {
@@ -1009,6 +1702,9 @@ IPCopeProtocol::SendHello()
 		helloHeader.Add(ip, mac, channel);
 		NS_LOG_FUNCTION("Add to hello header");
 	}
+	helloHeader.SetSequence(m_helloSeq++);
+	m_linkEstimator.Expire();
+	helloHeader.SetLinkReports(m_linkEstimator.GetReports());
 	//send hello from every and each IPCopeDevice
 	for(uint32_t i = 0; i<m_devices.size(); i++)
 	{
@@ -20,18 +20,28 @@
 
 #include "IPCope-header.h"
 #include "IPCope-packet-info.h"
+#include "IPCope-coding-index.h"
+#include "IPCope-coding-search.h"
+#include "IPCope-link-estimator.h"
+#include "IPCope-ack-tracker.h"
 #include "IPCope-queue.h"
 #include "IPCope-neighbor.h"
 #include "IPCope-packet-pool.h"
 #include "IPCope-device.h"
+#include "IPCope-xor.h"
+#include "IPCope-pid-tag.h"
+#include "IPCope-trace.h"
 #include <set>
 #include <vector>
 #include <map>
+#include <queue>
+#include <functional>
 #include "ns3/mac48-address.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/timer.h"
 #include "ns3/net-device.h"
+#include "ns3/traced-callback.h"
 #include <cstdlib>
 
 #ifndef COPEPROTOCOL_H
@@ -40,6 +50,14 @@
 namespace ns3{
 namespace ipcope{
 
+//which radio a unicast packet goes out on when its nexthop listens on several
+enum InterfacePolicy {
+	INTERFACE_FIRST_IDLE = 0, //the first idle radio that gets to it
+	INTERFACE_SHORTEST_QUEUE = 1, //the idle radio with the fewest packets in its mac queue
+	INTERFACE_ETX = 2, //the least expected airtime: etx of the link times the packets ahead
+	INTERFACE_ROUND_ROBIN = 3
+};
+
 /*
 struct NICStruct
 {
@@ -63,11 +81,13 @@ public:
 	IPCopeProtocol(bool arq);
 	IPCopeProtocol(bool arq, double rttime, double hello);
 	*/
-	IPCopeProtocol(bool arq, double rttime, double retrytime, double hello);
 	~IPCopeProtocol();
 	bool Encode(IPCopeQueueEntry & entry, Ptr<Packet> & packet, IPCopeHeader & copeHeader);
 	Ptr<Packet> XOR(Ptr<const Packet> p1, Ptr<const Packet> p2);
+	Ptr<Packet> XorMany(const std::vector<Ptr<const Packet> > & packets);
+	Ptr<Packet> XorMany(Ptr<const Packet> packet, const std::vector<XorSource> & sources);
 	int64_t Decode(const IPCopeHeader & header, Ptr<Packet> & packet);
+	void AddRecpReports(IPCopeHeader & header);
 	void Retransmit();
 	bool Enqueue(Ptr<Packet> packet, const Mac48Address& src, const Mac48Address& dest, const uint16_t protocolNumber, const uint32_t index, const MessageType type);
 
@@ -82,11 +102,16 @@ public:
 	void AddIP(Ipv4Address & ip);
 	Ipv4Address GetIP(uint32_t index) const;
 	Ipv4Address GetIP() const;
-	void DoSend(); 
+	bool DoSend(uint32_t iface);
 	void TrySend();
 	void TrySendSchedule() ;
+	void NotifyTxReady(uint32_t index);
+	void SetPolling(bool polling);
+	bool GetPolling() const;
+	//use IPCOPE_PACKET_TRACE rather than calling these directly
+	inline bool IsTracingPackets() const { return m_printPackets || m_tracePackets; }
+	void TracePacket(const std::string & where, Ptr<const Packet> packet);
 	void Init();
-	void AddAck(AckBlock ack);
 	void AddMac(const Mac48Address & mac);
 	void SetNode(Ptr<Node> node);
 	Ptr<Node> GetNode() const;
@@ -94,11 +119,59 @@ public:
 	void DoSendEnd();
 	void StartHello();
 
+	void SetRetransmitTimeout(Time timeout);
+	Time GetRetransmitTimeout() const;
+	void SetMinRto(Time rto);
+	Time GetMinRto() const;
+	void SetMaxRto(Time rto);
+	Time GetMaxRto() const;
+	void SetTrySendInterval(Time interval);
+	Time GetTrySendInterval() const;
+	void SetHelloInterval(Time interval);
+	Time GetHelloInterval() const;
+	void SetQueueMaxSize(uint32_t size);
+	uint32_t GetQueueMaxSize() const;
+	uint32_t GetMacQueueDepth() const { return m_macQueueDepth; }
+	void SetPoolCapacity(uint32_t capacity);
+	uint32_t GetPoolCapacity() const;
+	void SetPoolMaxAge(Time maxAge);
+	Time GetPoolMaxAge() const;
+	void SetPacketInfoMaxAge(Time maxAge);
+	Time GetPacketInfoMaxAge() const;
+	const IPCopePacketPool & GetPacketPool() const; //hit/miss/eviction counters
+	//natives that went out coded, and what they took on the air
+	uint64_t GetNativeBytesCoded() const { return m_nativeBytesCoded; }
+	uint64_t GetCodedBytesSent() const { return m_codedBytesSent; }
+	double GetBytesSavedRatio() const;
+	void SetLinkEstimateWeight(double weight);
+	double GetLinkEstimateWeight() const;
+	const IPCopeLinkEstimator & GetLinkEstimator() const;
+
 private:
 	uint32_t Index(const Mac48Address & src) const;
 	uint32_t Index(uint16_t channel) const;
 	void SendHello();
 	void HelloTimerExpire();
+	void LearnHolder(uint32_t pid, const Mac48Address & mac);
+	void InvalidateCodingHead(const Mac48Address & mac);
+	void SyncPrimaryMacs();
+	void RefreshCodingIndex();
+	Mac48Address NexthopKey(const Mac48Address & destMac);
+	void ArmRetransmit(IPCopeQueueEntry entry);
+	void ScheduleRetransmit();
+	void Classify(const IPCopeQueueHandle & handle, bool front);
+	bool PickEntry(uint32_t iface, IPCopeQueueHandle & handle);
+	void ReleaseChosen(uint32_t iface);
+	uint32_t SelectInterface(uint32_t iface, const IPCopeNeighbor & neighbor);
+	double InterfaceCost(uint32_t iface, const IPCopeNeighbor & neighbor) const;
+
+	//an entry of m_rtqueue falls due; stale once the entry is acked or re-armed
+	struct RetransmitDeadline
+	{
+		Time deadline;
+		uint32_t pid;
+		bool operator> (const RetransmitDeadline & other) const { return deadline > other.deadline; }
+	};
 private:
 	std::vector<Ptr<IPCopeDevice> > m_devices;
 	std::vector<Ipv4Address> m_ips;
@@ -106,15 +179,32 @@ private:
 	IPCopeNeighbors m_neighbors;
 	IPCopeQueue m_queue; //Output queue
 	IPCopeQueue m_rtqueue; //Retransmission queue
-	Timer m_timer;
+	std::priority_queue<RetransmitDeadline, std::vector<RetransmitDeadline>, std::greater<RetransmitDeadline> > m_rtDeadlines;
+	Timer m_timer; //fires at the earliest deadline
 	Time m_rtimeout;
+	uint8_t m_retryLimit;
+	double m_rtoBackoff;
 	Timer m_try;
 	Time m_ttimeout;
+	bool m_polling; //re-run TrySend every m_ttimeout on top of the device notifications
+	EventId m_trySendEvent;
 	Timer m_helloTimer;
 	Time m_helloInterval;
 	IPCopePacketInfo m_packetInfo;
+	IPCopeCodingIndex m_codingIndex;
+	uint32_t m_codingIndexVersion; //m_neighbors.GetVersion() the index was last checked against
+	uint32_t m_primaryMacsVersion; //and the neighbor ids and ack links
+	uint32_t m_lookAhead;
+	uint32_t m_codingSearchBudget;
+	double m_maxPaddingRatio;
+	double m_codingThreshold;
+	IPCopeLinkEstimator m_linkEstimator;
+	uint16_t m_helloSeq;
+	uint64_t m_nativeBytesCoded;
+	uint64_t m_codedBytesSent;
+	TracedCallback<uint32_t, uint32_t, uint32_t> m_codedPacketTrace;
 	IPCopePacketPool m_pool;
-	std::vector<AckBlock> m_ackBlockList;
+	IPCopeAckTracker m_acks;
 	bool m_isSending;
 	Ipv4Mask m_mask;
 	//bool m_arq;
@@ -123,8 +213,17 @@ private:
 	Ptr<Node> m_node;
 	//std::vector<NIC> m_neighborNICs;
 	std::vector<uint32_t> m_devicesIf;
-	std::deque<uint32_t> m_recps;
+	InterfacePolicy m_interfacePolicy;
+	uint32_t m_lastIface; //round robin
+	std::map<Ipv4Address, std::set<uint16_t> > m_recps; //received ip ids by source, not reported yet
 	uint16_t m_maxReports;
+	uint16_t m_maxAcks;
+	uint32_t m_macQueueDepth;
+	bool m_printPackets;
+	bool m_tracePackets;
+	TracedCallback<const std::string &, Ptr<const Packet> > m_packetTrace;
+	IPCopeXorBuffer m_codeBuffer; //scratch for XOR, reused across calls
+	IPCopeXorBuffer m_operandBuffer;
 };
 
 
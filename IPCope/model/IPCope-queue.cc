@@ -25,84 +25,230 @@ NS_LOG_COMPONENT_DEFINE("IPCopeQueue");
 namespace ns3{
 namespace ipcope{
 
-IPCopeQueueEntry::IPCopeQueueEntry()
+IPCopeQueueEntry::IPCopeQueueEntry():
+	m_packetId(0),
+	m_protocolNumber(0),
+	m_iface(0),
+	m_ifaceChosen(false),
+	m_type(DATA)
 {
 	m_retry = 0;
 	m_packet = Create<Packet>();
 }
-IPCopeQueueEntry::IPCopeQueueEntry(Ptr<Packet> packet)
+IPCopeQueueEntry::IPCopeQueueEntry(Ptr<Packet> packet):
+	m_packetId(0),
+	m_protocolNumber(0),
+	m_iface(0),
+	m_ifaceChosen(false),
+	m_type(DATA)
 {	
 	m_retry = 0;
 	m_packet = packet->Copy();
 }
 IPCopeQueueEntry::~IPCopeQueueEntry(){}
-IPCopeQueue::IPCopeQueue()
+const uint32_t IPCopeQueue::NONE;
+
+IPCopeQueue::IPCopeQueue():
+	m_head(NONE),
+	m_tail(NONE),
+	m_free(NONE),
+	m_size(0)
 {
-	m_queue.clear();
 	m_max = 800;
 }
 IPCopeQueue::~IPCopeQueue()
 {
 }
 
+/*
+ * Links a copy of entry in front of node before, or at the tail for NONE.
+ */
+uint32_t
+IPCopeQueue::Insert(const IPCopeQueueEntry & entry, uint32_t before)
+{
+	uint32_t node;
+	if(m_free != NONE)
+	{
+		node = m_free;
+		m_free = m_nodes[node].next;
+	}
+	else
+	{
+		node = m_nodes.size();
+		m_nodes.push_back(QueueNode());
+		m_nodes[node].generation = 0;
+	}
+	QueueNode & n = m_nodes[node];
+	n.entry = entry;
+	n.next = before;
+	n.prev = (before == NONE) ? m_tail : m_nodes[before].prev;
+	if(n.prev == NONE)
+		m_head = node;
+	else
+		m_nodes[n.prev].next = node;
+	if(before == NONE)
+		m_tail = node;
+	else
+		m_nodes[before].prev = node;
+	if(!entry.IsHello())
+		m_index[entry.GetPacketId()] = node;
+	m_size++;
+	return node;
+}
+
+void
+IPCopeQueue::Remove(uint32_t node)
+{
+	QueueNode & n = m_nodes[node];
+	if(n.prev == NONE)
+		m_head = n.next;
+	else
+		m_nodes[n.prev].next = n.next;
+	if(n.next == NONE)
+		m_tail = n.prev;
+	else
+		m_nodes[n.next].prev = n.prev;
+	if(!n.entry.IsHello())
+		m_index.erase(n.entry.GetPacketId());
+	n.entry.m_packet = 0; //don't keep the packet alive in the free list
+	n.generation++;
+	n.next = m_free;
+	m_free = node;
+	m_size--;
+}
+
 bool
 IPCopeQueue::EnqueueBack(const IPCopeQueueEntry & entry)
 {
-	if(m_queue.size() == m_max)
+	if(m_size >= m_max)
 	{
-		NS_LOG_FUNCTION(this<<"Queue full "<<m_queue.size());
+		NS_LOG_FUNCTION(this<<"Queue full "<<m_size);
 		return false;
 	}
-	std::list<IPCopeQueueEntry>::iterator iter;
-	for(iter = m_queue.begin(); iter != m_queue.end(); iter++)
-		if(iter->GetPacketId() == entry.GetPacketId())
-			return false;
-	m_queue.push_back(entry);
-	NS_LOG_FUNCTION(this<<m_queue.size()<<entry.GetPacketId());
+	if(!entry.IsHello() && m_index.find(entry.GetPacketId()) != m_index.end())
+		return false;
+	Insert(entry, NONE);
+	NS_LOG_FUNCTION(this<<m_size<<entry.GetPacketId());
 	return true;
 }
 
 bool
 IPCopeQueue::EnqueueFront(const IPCopeQueueEntry & entry)
 {
-	if(m_queue.size() == m_max)
+	if(m_size >= m_max)
 	{
-		NS_LOG_FUNCTION(this<<"Queue full "<<m_queue.size());
+		NS_LOG_FUNCTION(this<<"Queue full "<<m_size);
 		return false;
 	}
-	std::list<IPCopeQueueEntry>::iterator iter;
-	for(iter = m_queue.begin(); iter != m_queue.end(); iter++)
-		if(iter->GetPacketId() == entry.GetPacketId())
-			return false;
-	m_queue.push_front(entry);
+	if(!entry.IsHello() && m_index.find(entry.GetPacketId()) != m_index.end())
+		return false;
+	Insert(entry, m_head);
 	NS_LOG_FUNCTION_NOARGS();
 	return true;
 }
 
-IPCopeQueueEntry *
-IPCopeQueue::LastPosition() 
+IPCopeQueueHandle
+IPCopeQueue::BackHandle() const
 {
 	NS_LOG_FUNCTION_NOARGS();
-	//return &(m_queue.at(m_queue.size() - 1));
-	return &(m_queue.back());
+	NS_ASSERT(m_tail != NONE);
+	IPCopeQueueHandle handle = {m_tail, m_nodes[m_tail].generation};
+	return handle;
+}
+
+IPCopeQueueHandle
+IPCopeQueue::FrontHandle() const
+{
+	NS_LOG_FUNCTION_NOARGS();
+	NS_ASSERT(m_head != NONE);
+	IPCopeQueueHandle handle = {m_head, m_nodes[m_head].generation};
+	return handle;
 }
 
 IPCopeQueueEntry *
-IPCopeQueue::FirstPosition() 
+IPCopeQueue::Get(const IPCopeQueueHandle & handle)
+{
+	if(handle.index >= m_nodes.size() || m_nodes[handle.index].generation != handle.generation)
+		return 0;
+	return &(m_nodes[handle.index].entry);
+}
+
+IPCopeQueueEntry*
+IPCopeQueue::Find(uint32_t pid)
+{
+	std::tr1::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_index.find(pid);
+	if(iter == m_index.end())
+		return 0;
+	return &(m_nodes[iter->second].entry);
+}
+
+IPCopeQueueEntry
+IPCopeQueue::Take(const IPCopeQueueHandle & handle)
 {
 	NS_LOG_FUNCTION_NOARGS();
-	//return &(m_queue.at(0));
-	return &(m_queue.front());
+	if(!Get(handle))
+		NS_FATAL_ERROR("Try to take an entry that has left the queue");
+	IPCopeQueueEntry entry = m_nodes[handle.index].entry;
+	Remove(handle.index);
+	return entry;
+}
+
+void
+IPCopeQueue::AddToLane(uint32_t lane, const IPCopeQueueHandle & handle, bool front)
+{
+	if(lane >= m_lanes.size())
+		m_lanes.resize(lane + 1);
+	std::deque<IPCopeQueueHandle> & handles = m_lanes[lane];
+	//a lane that is rarely served fills up with handles of entries sent on others
+	if(handles.size() > 2 * m_max)
+	{
+		std::deque<IPCopeQueueHandle> live;
+		for(uint32_t i = 0; i<handles.size(); i++)
+		{
+			if(Get(handles[i]))
+				live.push_back(handles[i]);
+		}
+		handles.swap(live);
+	}
+	if(front)
+		handles.push_front(handle);
+	else
+		handles.push_back(handle);
+}
+
+bool
+IPCopeQueue::LaneFront(uint32_t lane, IPCopeQueueHandle & handle)
+{
+	if(lane >= m_lanes.size())
+		return false;
+	std::deque<IPCopeQueueHandle> & handles = m_lanes[lane];
+	while(handles.size())
+	{
+		if(Get(handles.front()))
+		{
+			handle = handles.front();
+			return true;
+		}
+		handles.pop_front();
+	}
+	return false;
+}
+
+void
+IPCopeQueue::PopLane(uint32_t lane)
+{
+	if(lane < m_lanes.size() && m_lanes[lane].size())
+		m_lanes[lane].pop_front();
 }
 
 IPCopeQueueEntry
 IPCopeQueue::Dequeue()
 {
 	NS_LOG_FUNCTION_NOARGS();
-	if(!m_queue.size())
+	if(!m_size)
 		NS_FATAL_ERROR("Try dequeue from a empty list");
-	IPCopeQueueEntry entry = m_queue.front();
-	m_queue.pop_front();
+	IPCopeQueueEntry entry = m_nodes[m_head].entry;
+	Remove(m_head);
 	return entry;
 }
 
@@ -110,26 +256,20 @@ IPCopeQueueEntry
 IPCopeQueue::Front() const
 {
 	NS_LOG_FUNCTION_NOARGS();
-	if(!m_queue.size())
+	if(!m_size)
 		NS_FATAL_ERROR("Try dequeue from a empty list");
-	return  m_queue.front();
+	return m_nodes[m_head].entry;
 }
 
 bool
 IPCopeQueue::Erase(uint32_t pid)
 {
 	NS_LOG_FUNCTION(this<<pid);
-	//std::deque<IPCopeQueueEntry>::iterator iter;
-	std::list<IPCopeQueueEntry>::iterator iter;
-	for(iter = m_queue.begin(); iter!= m_queue.end(); iter++)
-	{
-		if(iter->GetPacketId() == pid)
-		{
-			m_queue.erase(iter);
-			return true;
-		}
-	}
-	return false;
+	std::tr1::unordered_map<uint32_t, uint32_t>::iterator iter = m_index.find(pid);
+	if(iter == m_index.end())
+		return false;
+	Remove(iter->second);
+	return true;
 }
 
 /*
@@ -384,17 +524,20 @@ IPCopeQueueEntry::operator= (const IPCopeQueueEntry& ent)
 	this->m_srcMac = ent.m_srcMac;
 	this->m_destMac = ent.m_destMac;
 	this->m_iface = ent.m_iface;
+	this->m_ifaceChosen = ent.m_ifaceChosen;
 	this->m_type = ent.m_type;
 	this->m_retry = ent.m_retry;
+	this->m_sendTime = ent.m_sendTime;
+	this->m_deadline = ent.m_deadline;
 
 	return *this;
 }
 
 bool
-IPCopeQueueEntry::HitMax() const
+IPCopeQueueEntry::HitMax(uint32_t limit) const
 {
-	NS_LOG_FUNCTION(this<<(uint16_t)m_retry);
-	return (m_retry == 3);
+	NS_LOG_FUNCTION(this<<(uint16_t)m_retry<<limit);
+	return (m_retry >= limit);
 }
 
 void
@@ -408,13 +551,12 @@ void
 IPCopeQueue::Print(std::ostream &os) const
 {
 	NS_LOG_FUNCTION_NOARGS();
-	os<<"Current queue size is "<<m_queue.size()<<std::endl;
-	//std::deque<IPCopeQueueEntry>::const_iterator iter;
-	std::list<IPCopeQueueEntry>::const_iterator iter;
-	for(iter = m_queue.begin(); iter!= m_queue.end(); iter++)
+	os<<"Current queue size is "<<m_size<<std::endl;
+	for(uint32_t node = m_head; node != NONE; node = m_nodes[node].next)
 	{
-		os<<iter->GetPacketId()<<" "<<iter->GetDestMac()
-			<< " "<<iter->GetNexthop()<<std::endl;
+		const IPCopeQueueEntry & entry = m_nodes[node].entry;
+		os<<entry.GetPacketId()<<" "<<entry.GetDestMac()
+			<< " "<<entry.GetNexthop()<<std::endl;
 	}
 }
 
@@ -25,8 +25,11 @@
 #include "ns3/wifi-mac-header.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/wifi-mac-queue.h"
+#include "ns3/nstime.h"
 #include <deque>
 #include <list>
+#include <vector>
+#include <tr1/unordered_map>
 #include "IPCope-header.h"
 #include "IPCope-hash.h"
 #include "ns3/log.h"
@@ -73,13 +76,23 @@ public:
 	*/
 	void SetIface(uint32_t iface);
 	uint32_t GetIface() const;
+	//set once the interface policy has settled which radio sends it this time
+	inline void SetIfaceChosen(bool chosen) { m_ifaceChosen = chosen; }
+	inline bool IsIfaceChosen() const { return m_ifaceChosen; }
 	void SetHello();
 	void SetData();
 	bool IsHello() const;
-	bool HitMax() const;
+	bool HitMax(uint32_t limit) const;
 	void Retry();
+	inline uint8_t GetRetry() const { return m_retry; }
+	//when it was last sent coded and when it is due for retransmission
+	inline void SetSendTime(Time time) { m_sendTime = time; }
+	inline Time GetSendTime() const { return m_sendTime; }
+	inline void SetDeadline(Time deadline) { m_deadline = deadline; }
+	inline Time GetDeadline() const { return m_deadline; }
 
 private:
+	friend class IPCopeQueue;
 	Ptr<Packet> m_packet;
 	Mac48Address m_srcMac;
 	Mac48Address m_destMac;
@@ -91,10 +104,37 @@ private:
 	uint16_t m_protocolNumber;
 	//uint16_t m_channel;
 	uint32_t m_iface;
+	bool m_ifaceChosen;
 	MessageType m_type;
 	uint8_t m_retry; //number of rertansmission
+	Time m_sendTime;
+	Time m_deadline;
 };
 
+/*
+ * Refers to an entry of an IPCopeQueue. The generation changes every time
+ * the node is freed, so a handle to an entry that has since left the queue
+ * resolves to nothing instead of to whatever reused the node.
+ */
+struct IPCopeQueueHandleStruct
+{
+	uint32_t index;
+	uint32_t generation;
+};
+
+typedef struct IPCopeQueueHandleStruct IPCopeQueueHandle;
+
+/*
+ * Output queue. Entries live in a slab of nodes linked into a doubly linked
+ * list, with freed nodes recycled through a free list, and data entries are
+ * indexed by pid so the duplicate check and Erase don't walk the queue.
+ * Hello entries carry no pid and are neither indexed nor deduplicated.
+ *
+ * Lanes are per-interface views of the queue, in queue order, that the
+ * caller fills with handles of the entries each interface may send. An
+ * entry can sit in several lanes; once it leaves the queue its handles
+ * are skipped.
+ */
 class IPCopeQueue
 {
 public:
@@ -113,14 +153,38 @@ public:
 	*/
 	IPCopeQueueEntry Dequeue();
 	IPCopeQueueEntry Front() const;
-	inline uint32_t Size() const { return m_queue.size(); }
-	IPCopeQueueEntry* LastPosition() ;
-	IPCopeQueueEntry* FirstPosition() ;
+	inline uint32_t Size() const { return m_size; }
+	IPCopeQueueHandle BackHandle() const;
+	IPCopeQueueHandle FrontHandle() const;
+	IPCopeQueueEntry* Get(const IPCopeQueueHandle & handle); //0 once the entry has left the queue
+	IPCopeQueueEntry* Find(uint32_t pid); //0 if no data entry has that pid
+	IPCopeQueueEntry Take(const IPCopeQueueHandle & handle); //removes an entry from anywhere in the queue
+	void AddToLane(uint32_t lane, const IPCopeQueueHandle & handle, bool front);
+	bool LaneFront(uint32_t lane, IPCopeQueueHandle & handle); //false if no entry of the lane is left
+	void PopLane(uint32_t lane);
 	void Print(std::ostream &os) const;
-	void SetMaxSize(uint32_t size);
+	void SetMaxSize(uint32_t size); //queued entries stay; enqueues are refused until the queue is below it
+	uint32_t GetMaxSize() const { return m_max; }
 private:
-	std::list<IPCopeQueueEntry> m_queue;
+	static const uint32_t NONE = 0xffffffff;
+	struct QueueNode
+	{
+		IPCopeQueueEntry entry;
+		uint32_t prev;
+		uint32_t next;
+		uint32_t generation;
+	};
+	uint32_t Insert(const IPCopeQueueEntry & entry, uint32_t before);
+	void Remove(uint32_t node);
+
+	std::deque<QueueNode> m_nodes;
+	uint32_t m_head;
+	uint32_t m_tail;
+	uint32_t m_free; //singly linked through next
+	uint32_t m_size;
+	std::tr1::unordered_map<uint32_t, uint32_t> m_index; //pid -> node
 	uint32_t m_max;
+	std::vector<std::deque<IPCopeQueueHandle> > m_lanes;
 };
 
 }//namespace cope
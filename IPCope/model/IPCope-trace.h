@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+#ifndef COPETRACE_H
+#define COPETRACE_H
+
+/*
+ * Packet dumps on the data path. IPCOPE_PACKET_TRACE(cope, where, packet)
+ * hands the packet to IPCopeProtocol::TracePacket, which fires the
+ * "PacketTrace" trace source and prints it if "PrintPackets" is set. The
+ * check is a single flag test, and the whole thing compiles away in builds
+ * without logging (optimized builds), like NS_LOG.
+ */
+#ifdef NS3_LOG_ENABLE
+#define IPCOPE_PACKET_TRACE(cope, where, packet)	\
+	do	\
+	{	\
+		if((cope)->IsTracingPackets())	\
+			(cope)->TracePacket(where, packet);	\
+	} while(false)
+#else
+#define IPCOPE_PACKET_TRACE(cope, where, packet)	\
+	do	\
+	{	\
+	} while(false)
+#endif
+
+#endif
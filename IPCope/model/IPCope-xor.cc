@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+#include "IPCope-xor.h"
+#include "ns3/log.h"
+#include <string.h>
+
+/*
+ * The SSE2/AVX2 kernels are compiled with per-function target attributes so
+ * the module itself doesn't need -mavx2; which one runs is decided at runtime.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define IPCOPE_XOR_X86 1
+#include <immintrin.h>
+#endif
+
+NS_LOG_COMPONENT_DEFINE("IPCopeXor");
+
+namespace ns3{
+namespace ipcope{
+
+static void
+XorByte(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	for(uint32_t i = 0; i<len; i++)
+		dst[i] ^= src[i];
+}
+
+static void
+XorWord(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	uint32_t i = 0;
+	//memcpy keeps the unaligned loads legal; compilers turn it into a plain mov
+	for(; i+32 <= len; i += 32)
+	{
+		uint64_t a[4], b[4];
+		memcpy(a, dst+i, 32);
+		memcpy(b, src+i, 32);
+		a[0] ^= b[0];
+		a[1] ^= b[1];
+		a[2] ^= b[2];
+		a[3] ^= b[3];
+		memcpy(dst+i, a, 32);
+	}
+	for(; i+8 <= len; i += 8)
+	{
+		uint64_t a, b;
+		memcpy(&a, dst+i, 8);
+		memcpy(&b, src+i, 8);
+		a ^= b;
+		memcpy(dst+i, &a, 8);
+	}
+	XorByte(dst+i, src+i, len-i);
+}
+
+#ifdef IPCOPE_XOR_X86
+__attribute__((target("sse2"))) static void
+XorSse2(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	uint32_t i = 0;
+	for(; i+64 <= len; i += 64)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(dst+i));
+		__m128i a1 = _mm_loadu_si128((const __m128i *)(dst+i+16));
+		__m128i a2 = _mm_loadu_si128((const __m128i *)(dst+i+32));
+		__m128i a3 = _mm_loadu_si128((const __m128i *)(dst+i+48));
+		a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i *)(src+i)));
+		a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i *)(src+i+16)));
+		a2 = _mm_xor_si128(a2, _mm_loadu_si128((const __m128i *)(src+i+32)));
+		a3 = _mm_xor_si128(a3, _mm_loadu_si128((const __m128i *)(src+i+48)));
+		_mm_storeu_si128((__m128i *)(dst+i), a0);
+		_mm_storeu_si128((__m128i *)(dst+i+16), a1);
+		_mm_storeu_si128((__m128i *)(dst+i+32), a2);
+		_mm_storeu_si128((__m128i *)(dst+i+48), a3);
+	}
+	for(; i+16 <= len; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(dst+i));
+		a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)(src+i)));
+		_mm_storeu_si128((__m128i *)(dst+i), a);
+	}
+	XorWord(dst+i, src+i, len-i);
+}
+
+__attribute__((target("avx2"))) static void
+XorAvx2(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	uint32_t i = 0;
+	for(; i+128 <= len; i += 128)
+	{
+		__m256i a0 = _mm256_loadu_si256((const __m256i *)(dst+i));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *)(dst+i+32));
+		__m256i a2 = _mm256_loadu_si256((const __m256i *)(dst+i+64));
+		__m256i a3 = _mm256_loadu_si256((const __m256i *)(dst+i+96));
+		a0 = _mm256_xor_si256(a0, _mm256_loadu_si256((const __m256i *)(src+i)));
+		a1 = _mm256_xor_si256(a1, _mm256_loadu_si256((const __m256i *)(src+i+32)));
+		a2 = _mm256_xor_si256(a2, _mm256_loadu_si256((const __m256i *)(src+i+64)));
+		a3 = _mm256_xor_si256(a3, _mm256_loadu_si256((const __m256i *)(src+i+96)));
+		_mm256_storeu_si256((__m256i *)(dst+i), a0);
+		_mm256_storeu_si256((__m256i *)(dst+i+32), a1);
+		_mm256_storeu_si256((__m256i *)(dst+i+64), a2);
+		_mm256_storeu_si256((__m256i *)(dst+i+96), a3);
+	}
+	for(; i+32 <= len; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i *)(dst+i));
+		a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *)(src+i)));
+		_mm256_storeu_si256((__m256i *)(dst+i), a);
+	}
+	//not XorSse2: legacy-encoded SSE right after ymm use pays the AVX/SSE transition penalty
+	XorWord(dst+i, src+i, len-i);
+}
+#endif
+
+typedef void (*XorFunction)(uint8_t *, const uint8_t *, uint32_t);
+
+bool
+IsXorKernelSupported(XorKernel kernel)
+{
+	switch(kernel)
+	{
+	case XOR_KERNEL_AUTO:
+	case XOR_KERNEL_BYTE:
+	case XOR_KERNEL_WORD:
+		return true;
+#ifdef IPCOPE_XOR_X86
+	case XOR_KERNEL_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case XOR_KERNEL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+XorKernel
+GetXorKernel()
+{
+	static XorKernel best = XOR_KERNEL_AUTO;
+	if(best == XOR_KERNEL_AUTO)
+	{
+		if(IsXorKernelSupported(XOR_KERNEL_AVX2))
+			best = XOR_KERNEL_AVX2;
+		else if(IsXorKernelSupported(XOR_KERNEL_SSE2))
+			best = XOR_KERNEL_SSE2;
+		else
+			best = XOR_KERNEL_WORD;
+		NS_LOG_DEBUG("XOR kernel: "<<GetXorKernelName(best));
+	}
+	return best;
+}
+
+const char *
+GetXorKernelName(XorKernel kernel)
+{
+	switch(kernel)
+	{
+	case XOR_KERNEL_AUTO:
+		return "auto";
+	case XOR_KERNEL_BYTE:
+		return "byte";
+	case XOR_KERNEL_WORD:
+		return "word64";
+	case XOR_KERNEL_SSE2:
+		return "sse2";
+	case XOR_KERNEL_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+static XorFunction
+Resolve(XorKernel kernel)
+{
+	if(kernel == XOR_KERNEL_AUTO)
+		kernel = GetXorKernel();
+	NS_ASSERT(IsXorKernelSupported(kernel));
+	switch(kernel)
+	{
+	case XOR_KERNEL_BYTE:
+		return &XorByte;
+#ifdef IPCOPE_XOR_X86
+	case XOR_KERNEL_SSE2:
+		return &XorSse2;
+	case XOR_KERNEL_AVX2:
+		return &XorAvx2;
+#endif
+	default:
+		return &XorWord;
+	}
+}
+
+void
+XorInto(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	static XorFunction xorFunction = Resolve(XOR_KERNEL_AUTO);
+	xorFunction(dst, src, len);
+}
+
+void
+XorInto(uint8_t *dst, const uint8_t *src, uint32_t len, XorKernel kernel)
+{
+	Resolve(kernel)(dst, src, len);
+}
+
+IPCopeXorBuffer::IPCopeXorBuffer(){}
+IPCopeXorBuffer::~IPCopeXorBuffer(){}
+
+uint8_t*
+IPCopeXorBuffer::Get(uint32_t size)
+{
+	if(size > m_buffer.size() || m_buffer.empty())
+		m_buffer.resize(size ? size : 1);
+	return &m_buffer[0];
+}
+
+uint8_t*
+IPCopeXorBuffer::GetZeroed(uint32_t size)
+{
+	uint8_t *buffer = Get(size);
+	memset(buffer, 0, size);
+	return buffer;
+}
+
+}//namespace ipcope
+}//namespace ns3
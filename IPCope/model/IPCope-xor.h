@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2010 Yang CHI, CDMC, University of Cincinnati
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Yang CHI <chiyg@mail.uc.edu>
+ */
+
+#ifndef COPEXOR_H
+#define COPEXOR_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3{
+namespace ipcope{
+
+enum XorKernel {
+	XOR_KERNEL_AUTO = 0, //widest kernel the running cpu supports
+	XOR_KERNEL_BYTE = 1,
+	XOR_KERNEL_WORD = 2, //64-bit words
+	XOR_KERNEL_SSE2 = 3,
+	XOR_KERNEL_AVX2 = 4
+};
+
+/*
+ * A flat, read-only view of a payload, e.g. one held by IPCopePacketPool.
+ */
+struct XorSourceStruct
+{
+	const uint8_t *data;
+	uint32_t size;
+};
+
+typedef struct XorSourceStruct XorSource;
+
+/*
+ * dst[i] ^= src[i] for i in [0, len). Buffers may be unaligned but must not overlap.
+ */
+void XorInto(uint8_t *dst, const uint8_t *src, uint32_t len);
+void XorInto(uint8_t *dst, const uint8_t *src, uint32_t len, XorKernel kernel);
+
+bool IsXorKernelSupported(XorKernel kernel);
+XorKernel GetXorKernel(); //the kernel XOR_KERNEL_AUTO resolves to
+const char * GetXorKernelName(XorKernel kernel);
+
+/*
+ * Grow-only scratch memory for the coding path, so that encoding and
+ * decoding don't hit the allocator once the largest packet has been seen.
+ */
+class IPCopeXorBuffer
+{
+public:
+	IPCopeXorBuffer();
+	~IPCopeXorBuffer();
+	uint8_t* Get(uint32_t size);
+	uint8_t* GetZeroed(uint32_t size);
+	uint32_t Capacity() const { return m_buffer.size(); }
+private:
+	std::vector<uint8_t> m_buffer;
+};
+
+}//namespace ipcope
+}//namespace ns3
+
+#endif
@@ -2,6 +2,23 @@
 
 // Include a header file from your module to test.
 #include "ns3/IPCope.h"
+#include "ns3/IPCope-xor.h"
+#include "ns3/IPCope-header.h"
+#include "ns3/IPCope-packet-pool.h"
+#include "ns3/IPCope-packet-info.h"
+#include "ns3/IPCope-coding-index.h"
+#include "ns3/IPCope-coding-search.h"
+#include "ns3/IPCope-queue.h"
+#include "ns3/IPCope-neighbor.h"
+#include "ns3/IPCope-hash.h"
+#include "ns3/IPCope-link-estimator.h"
+#include "ns3/IPCope-ack-tracker.h"
+#include "ns3/IPCope-pid-tag.h"
+#include "ns3/IPCope-protocol.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include <string.h>
+#include <algorithm>
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +63,877 @@ IpcopeTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Every XOR kernel must agree with the plain byte loop, whatever the
+// length and alignment of the buffers.
+class IpcopeXorTestCase : public TestCase
+{
+public:
+  IpcopeXorTestCase ();
+  virtual ~IpcopeXorTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeXorTestCase::IpcopeXorTestCase ()
+  : TestCase ("Ipcope XOR kernels match the byte loop")
+{
+}
+
+IpcopeXorTestCase::~IpcopeXorTestCase ()
+{
+}
+
+void
+IpcopeXorTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  XorKernel kernels[] = { XOR_KERNEL_AUTO, XOR_KERNEL_WORD, XOR_KERNEL_SSE2, XOR_KERNEL_AVX2 };
+  uint32_t lengths[] = { 0, 1, 7, 8, 31, 64, 129, 1500, 9000 };
+  for (uint32_t k = 0; k < sizeof (kernels) / sizeof (kernels[0]); k++)
+    {
+      if (!IsXorKernelSupported (kernels[k]))
+        {
+          continue;
+        }
+      for (uint32_t l = 0; l < sizeof (lengths) / sizeof (lengths[0]); l++)
+        {
+          for (uint32_t offset = 0; offset < 3; offset++)
+            {
+              uint32_t len = lengths[l];
+              std::vector<uint8_t> dst (len + offset + 1), src (len + offset + 1), expected;
+              for (uint32_t i = 0; i < dst.size (); i++)
+                {
+                  dst[i] = (uint8_t)(i * 31 + 5);
+                  src[i] = (uint8_t)(i * 17 + 3);
+                }
+              expected = dst;
+              XorInto (&expected[offset], &src[offset], len, XOR_KERNEL_BYTE);
+              XorInto (&dst[offset], &src[offset], len, kernels[k]);
+              NS_TEST_ASSERT_MSG_EQ ((dst == expected), true, "kernel " << GetXorKernelName (kernels[k])
+                                     << " differs for length " << len << " offset " << offset);
+            }
+        }
+    }
+}
+
+// Native lengths and reception reports must survive a trip through the
+// wire format, including for natives whose payload ends in zero bytes.
+class IpcopeHeaderTestCase : public TestCase
+{
+public:
+  IpcopeHeaderTestCase ();
+  virtual ~IpcopeHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeHeaderTestCase::IpcopeHeaderTestCase ()
+  : TestCase ("Ipcope header carries native lengths")
+{
+}
+
+IpcopeHeaderTestCase::~IpcopeHeaderTestCase ()
+{
+}
+
+void
+IpcopeHeaderTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  Mac48Address a ("00:00:00:00:00:01");
+  Mac48Address b ("00:00:00:00:00:02");
+  IPCopeHeader header;
+  header.SetIp (Ipv4Address ("10.0.0.1"));
+  header.AddIdNexthop (a, 1234, 40);
+  header.AddIdNexthop (b, 5678, 1500);
+  RecpReport report;
+  report.address = Ipv4Address ("10.0.0.2");
+  report.lastPkt = 1;
+  report.bitMap = 0x80000003; // ids 0, 65535 and 65505
+  NS_TEST_ASSERT_MSG_EQ (header.AddRecpReport (report), true, "report not added");
+  NS_TEST_ASSERT_MSG_EQ (header.AddRecpReport (report), false, "duplicate report added");
+
+  Ptr<Packet> packet = Create<Packet> (1500);
+  packet->AddHeader (header);
+  IPCopeHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetEncodedNum (), 2, "wrong number of natives");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNativeLength (a), 40, "wrong length for first native");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNativeLength (b), 1500, "wrong length for second native");
+  NS_TEST_ASSERT_MSG_EQ (received.GetReportNum (), 1, "wrong number of reports");
+  std::vector<uint16_t> ids = IPCopeHeader::Expand (received.GetRecpReports ()[0]);
+  NS_TEST_ASSERT_MSG_EQ (ids.size (), 4, "wrong number of reported ids");
+  NS_TEST_ASSERT_MSG_EQ (ids[0], 1, "last id not reported");
+  NS_TEST_ASSERT_MSG_EQ (ids[1], 0, "wrong id for bit 0");
+  NS_TEST_ASSERT_MSG_EQ (ids[2], 65535, "ids should wrap around");
+  NS_TEST_ASSERT_MSG_EQ (ids[3], 65505, "wrong id for bit 31");
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 1500, "header size mismatch");
+
+  // a native ending in zero bytes, coded with a longer one and decoded the
+  // way a nexthop holding the longer one does
+  uint8_t shortPayload[40];
+  uint8_t longPayload[1500];
+  memset (shortPayload, 0, sizeof (shortPayload));
+  for (uint32_t i = 0; i < 30; i++)
+    {
+      shortPayload[i] = i + 1;
+    }
+  for (uint32_t i = 0; i < sizeof (longPayload); i++)
+    {
+      longPayload[i] = i * 7;
+    }
+  Ptr<IPCopeProtocol> cope = CreateObject<IPCopeProtocol> ();
+  std::vector<Ptr<const Packet> > natives;
+  natives.push_back (Create<Packet> (shortPayload, sizeof (shortPayload)));
+  natives.push_back (Create<Packet> (longPayload, sizeof (longPayload)));
+  Ptr<Packet> coded = cope->XorMany (natives);
+  IPCopePacketPool pool;
+  pool.AddToPool (5678, Create<Packet> (longPayload, sizeof (longPayload)));
+  std::vector<XorSource> sources (1);
+  NS_TEST_ASSERT_MSG_EQ (pool.Find (5678, sources[0].data, sources[0].size), true, "native not pooled");
+  Ptr<Packet> decoded = cope->XorMany (coded, sources);
+  decoded->RemoveAtEnd (decoded->GetSize () - received.GetNativeLength (a));
+  uint8_t out[40];
+  NS_TEST_ASSERT_MSG_EQ (decoded->CopyData (out, sizeof (out)), 40, "decoded native has the wrong length");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (out, shortPayload, sizeof (out)), 0, "decoded native differs");
+}
+
+// A full pool evicts its oldest packet and keeps count of what happened.
+class IpcopePoolTestCase : public TestCase
+{
+public:
+  IpcopePoolTestCase ();
+  virtual ~IpcopePoolTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopePoolTestCase::IpcopePoolTestCase ()
+  : TestCase ("Ipcope packet pool is bounded")
+{
+}
+
+IpcopePoolTestCase::~IpcopePoolTestCase ()
+{
+}
+
+void
+IpcopePoolTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  IPCopePacketPool pool;
+  pool.SetCapacity (2);
+  pool.AddToPool (1, Create<Packet> (10));
+  pool.AddToPool (2, Create<Packet> (20));
+  pool.AddToPool (3, Create<Packet> (30));
+  Ptr<Packet> found;
+  NS_TEST_ASSERT_MSG_EQ (pool.Find (1, found), false, "oldest packet should have been evicted");
+  NS_TEST_ASSERT_MSG_EQ (pool.Find (3, found), true, "newest packet should be in the pool");
+  NS_TEST_ASSERT_MSG_EQ (found->GetSize (), 30, "wrong packet returned");
+  NS_TEST_ASSERT_MSG_EQ (pool.Size (), 2, "pool exceeds its capacity");
+  NS_TEST_ASSERT_MSG_EQ (pool.GetHits (), 1, "wrong hit count");
+  NS_TEST_ASSERT_MSG_EQ (pool.GetMisses (), 1, "wrong miss count");
+  NS_TEST_ASSERT_MSG_EQ (pool.GetEvictions (), 1, "wrong eviction count");
+
+  uint8_t payload[4] = { 1, 2, 3, 4 };
+  pool.AddToPool (4, Create<Packet> (payload, 4));
+  const uint8_t *data;
+  uint32_t size;
+  NS_TEST_ASSERT_MSG_EQ (pool.Find (4, data, size), true, "byte view lookup failed");
+  NS_TEST_ASSERT_MSG_EQ (size, 4, "wrong byte view size");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (data, payload, 4), 0, "byte view does not match the stored payload");
+}
+
+// Packet info answers who-has-what after the table has grown, and hands
+// out the ids of released neighbors again.
+class IpcopePacketInfoTestCase : public TestCase
+{
+public:
+  IpcopePacketInfoTestCase ();
+  virtual ~IpcopePacketInfoTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopePacketInfoTestCase::IpcopePacketInfoTestCase ()
+  : TestCase ("Ipcope packet info tracks holders per neighbor")
+{
+}
+
+IpcopePacketInfoTestCase::~IpcopePacketInfoTestCase ()
+{
+}
+
+void
+IpcopePacketInfoTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  IPCopePacketInfo info;
+  Mac48Address a ("00:00:00:00:00:01");
+  Mac48Address b ("00:00:00:00:00:02");
+  for (uint32_t pid = 0; pid < 1000; pid++)
+    {
+      info.SetItem (pid, pid % 2 ? a : b);
+    }
+  info.SetItem (7, b);
+  NS_TEST_ASSERT_MSG_EQ (info.Size (), 1000, "wrong number of packets tracked");
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (7, a), true, "a should have packet 7");
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (7, b), true, "b should have packet 7");
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (8, a), false, "a shouldn't have packet 8");
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (5000, a), false, "unknown packet reported as held");
+  NeighborBitmap holders = info.Holders (7);
+  NS_TEST_ASSERT_MSG_EQ (holders.Test (info.NeighborId (a)), true, "a missing from holders");
+  NS_TEST_ASSERT_MSG_EQ (holders.Test (info.NeighborId (b)), true, "b missing from holders");
+
+  Mac48Address c ("00:00:00:00:00:03");
+  uint32_t id = info.NeighborId (a);
+  info.RenameNeighbor (id, c);
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (7, c), true, "renamed neighbor lost its packets");
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (7, a), false, "old mac still tracked");
+  info.ReleaseNeighbor (id);
+  NS_TEST_ASSERT_MSG_EQ (info.IsNeighborId (id), false, "released id still in use");
+  NS_TEST_ASSERT_MSG_EQ (info.NeighborId (a), id, "released id not reused");
+  NS_TEST_ASSERT_MSG_EQ (info.GetItem (7, a), false, "reused id kept the packets of the released one");
+
+  IPCopePacketInfo full;
+  for (uint32_t i = 0; i < IPCOPE_MAX_NEIGHBORS; i++)
+    {
+      uint8_t mac[6] = { 0, 0, 0, 0, 1, (uint8_t)i };
+      Mac48Address address;
+      address.CopyFrom (mac);
+      full.NeighborId (address);
+    }
+  NS_TEST_ASSERT_MSG_EQ (full.NeighborId (a), IPCOPE_NO_NEIGHBOR, "id handed out past the limit");
+  full.SetItem (1, a);
+  NS_TEST_ASSERT_MSG_EQ (full.GetItem (1, a), false, "untracked neighbor reported as holder");
+}
+
+// The coding index follows heads and holders, forgets a head once it is
+// replaced and a neighbor once its id is released.
+class IpcopeCodingIndexTestCase : public TestCase
+{
+public:
+  IpcopeCodingIndexTestCase ();
+  virtual ~IpcopeCodingIndexTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeCodingIndexTestCase::IpcopeCodingIndexTestCase ()
+  : TestCase ("Ipcope coding index tracks who has which queue head")
+{
+}
+
+IpcopeCodingIndexTestCase::~IpcopeCodingIndexTestCase ()
+{
+}
+
+void
+IpcopeCodingIndexTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  IPCopeCodingIndex index;
+  NeighborBitmap holders;
+  holders.Set (1);
+  index.SetHead (0, 100, holders);
+  index.SetHead (1, 101, NeighborBitmap ());
+  NS_TEST_ASSERT_MSG_EQ (index.Pending ().Test (0), true, "0 should have a head");
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (1).Test (0), true, "1 holds the head of 0");
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (0).Test (1), false, "0 doesn't hold the head of 1 yet");
+  index.AddHolder (101, 0);
+  index.AddHolder (555, 0);
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (0).Test (1), true, "reported head not indexed");
+  NeighborBitmap candidates = index.Pending ();
+  candidates &= index.Knows (1);
+  NS_TEST_ASSERT_MSG_EQ (candidates.First (), 0, "0 should be codable with 1");
+  index.SetHead (0, 102, NeighborBitmap ());
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (1).Test (0), false, "holders of the old head kept");
+  index.AddHolder (100, 1);
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (1).Test (0), false, "old head still indexed");
+  index.Invalidate (1);
+  NS_TEST_ASSERT_MSG_EQ (index.Dirty ().Test (1), true, "1 should be dirty");
+  index.ClearHead (1);
+  NS_TEST_ASSERT_MSG_EQ (index.Dirty ().IsEmpty (), true, "1 still dirty");
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (0).Test (1), false, "cleared head still indexed");
+  NS_TEST_ASSERT_MSG_EQ (index.HasHead (1), false, "cleared head still pending");
+  index.SetHead (1, 103, NeighborBitmap ());
+  index.AddHolder (103, 0);
+  index.Forget (0);
+  NS_TEST_ASSERT_MSG_EQ (index.HasHead (0), false, "forgotten neighbor kept its head");
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (0).IsEmpty (), true, "forgotten neighbor still holds heads");
+  index.SetHead (0, 104, NeighborBitmap ());
+  index.SetHead (1, 105, NeighborBitmap ());
+  NS_TEST_ASSERT_MSG_EQ (index.Knows (0).IsEmpty (), true, "reused id inherited holdings");
+}
+
+// A native for neighbor id that the neighbors in the holders mask have; every
+// neighbor listens on channel 1.
+static ns3::ipcope::IPCopeCodingOption
+MakeCodingOption (uint32_t id, uint32_t length, uint32_t holders)
+{
+  ns3::ipcope::IPCopeCodingOption option;
+  option.neighborPos = id;
+  option.id = id;
+  option.depth = 0;
+  option.entry = 0;
+  for (uint32_t i = 0; i < 32; i++)
+    {
+      if (holders & (1u << i))
+        {
+          option.holders.Set (i);
+        }
+    }
+  option.length = length;
+  option.hasPrevHop = false;
+  option.channels.insert (1);
+  return option;
+}
+
+// The first native, for neighbor 0.
+static ns3::ipcope::IPCopeCodingSet
+MakeCodingSet (uint32_t length, uint32_t holders)
+{
+  ns3::ipcope::IPCopeCodingOption first = MakeCodingOption (0, length, holders);
+  ns3::ipcope::IPCopeCodingSet set;
+  set.nexthops.Set (0);
+  set.holders = first.holders;
+  set.channels = first.channels;
+  set.minLength = length;
+  set.maxLength = length;
+  set.bytes = length;
+  return set;
+}
+
+// Zero padding of the first native coded with options[members], or -1 if
+// some nexthop couldn't decode or a native would be padded beyond ratio.
+static int64_t
+CodingSetPadding (const ns3::ipcope::IPCopeCodingSet & set, const std::vector<ns3::ipcope::IPCopeCodingOption> & options,
+                  const std::vector<uint32_t> & members, double ratio)
+{
+  ns3::ipcope::NeighborBitmap nexthops = set.nexthops;
+  uint32_t minLength = set.minLength;
+  uint32_t maxLength = set.maxLength;
+  uint32_t bytes = set.bytes;
+  for (uint32_t i = 0; i < members.size (); i++)
+    {
+      const ns3::ipcope::IPCopeCodingOption & option = options[members[i]];
+      if (nexthops.Test (option.id))
+        {
+          return -1;
+        }
+      nexthops.Set (option.id);
+      minLength = std::min (minLength, option.length);
+      maxLength = std::max (maxLength, option.length);
+      bytes += option.length;
+    }
+  for (uint32_t i = 0; i < members.size (); i++)
+    {
+      ns3::ipcope::NeighborBitmap others = nexthops;
+      others.Clear (options[members[i]].id);
+      if (!options[members[i]].holders.Contains (others))
+        {
+          return -1;
+        }
+    }
+  nexthops.Clear (0);
+  if (!set.holders.Contains (nexthops) || maxLength - minLength > ratio * maxLength)
+    {
+      return -1;
+    }
+  return (int64_t)(members.size () + 1) * maxLength - bytes;
+}
+
+// Coding set search: length classes, look-ahead past a head nobody else can
+// decode, the budget, the padding cap and tie-break, and the size bound
+// against trying every subset.
+class IpcopeCodingSearchTestCase : public TestCase
+{
+public:
+  IpcopeCodingSearchTestCase ();
+  virtual ~IpcopeCodingSearchTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeCodingSearchTestCase::IpcopeCodingSearchTestCase ()
+  : TestCase ("Ipcope coding search finds the largest set with the least padding")
+{
+}
+
+IpcopeCodingSearchTestCase::~IpcopeCodingSearchTestCase ()
+{
+}
+
+void
+IpcopeCodingSearchTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (0), 0, "wrong class of an empty native");
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (63), 0, "wrong class under 64 bytes");
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (64), 1, "wrong class at 64 bytes");
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (127), 1, "wrong class under 128 bytes");
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (1500), 5, "wrong class of a full segment");
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (4095), 6, "wrong class under 4096 bytes");
+  NS_TEST_ASSERT_MSG_EQ (IPCopeCodingSearch::LengthClass (65535), IPCOPE_LENGTH_CLASSES - 1, "classes should stop at the last");
+
+  IPCopePacketInfo packetInfo;
+  IPCopeLinkEstimator linkEstimator;
+  IPCopeCodingSearch search (packetInfo, linkEstimator);
+  std::set<uint16_t> channels;
+  channels.insert (1);
+  search.SetFreeChannels (channels);
+  std::vector<uint32_t> best;
+  uint32_t budget;
+
+  // the head for 1 can't be decoded by 2, the native behind it can
+  IPCopeCodingSet set = MakeCodingSet (1000, 0x6);
+  std::vector<IPCopeCodingOption> options;
+  options.push_back (MakeCodingOption (1, 1000, 0x1));
+  options.push_back (MakeCodingOption (1, 1000, 0x5));
+  options[1].depth = 1;
+  options.push_back (MakeCodingOption (2, 1000, 0x3));
+  budget = 256;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.size (), 2, "looking past the head should code three natives");
+  NS_TEST_ASSERT_MSG_EQ (best[0], 1, "the head for 1 is in the way");
+  NS_TEST_ASSERT_MSG_EQ (best[1], 2, "2 should join");
+  NS_TEST_ASSERT_MSG_EQ (budget < 256, true, "budget not spent");
+  budget = 1;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.size (), 1, "one option examined should give the greedy pick");
+  NS_TEST_ASSERT_MSG_EQ (best[0], 0, "greedy pick should be the first option");
+  NS_TEST_ASSERT_MSG_EQ (budget, 0, "budget overspent");
+  options.erase (options.begin () + 1);
+  budget = 256;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.size (), 1, "heads alone can't code three natives");
+  channels.clear ();
+  channels.insert (6);
+  search.SetFreeChannels (channels);
+  budget = 256;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.empty (), true, "coded on a channel with no free interface");
+  channels.insert (1);
+  search.SetFreeChannels (channels);
+
+  // a TCP ack behind a full segment is padded by 97%
+  set = MakeCodingSet (1500, 0x2);
+  options.assign (1, MakeCodingOption (1, 40, 0x1));
+  budget = 256;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.size (), 1, "no padding cap by default");
+  search.SetMaxPaddingRatio (0.5);
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.empty (), true, "padding over the cap");
+  options[0].length = 1000;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.size (), 1, "padding within the cap rejected");
+  search.SetMaxPaddingRatio (1.0);
+
+  // either one of two natives, and the longer one pads less
+  set = MakeCodingSet (1500, 0x6);
+  options.clear ();
+  options.push_back (MakeCodingOption (1, 40, 0x1));
+  options.push_back (MakeCodingOption (2, 1400, 0x1));
+  budget = 256;
+  search.Search (options, set, best, budget);
+  NS_TEST_ASSERT_MSG_EQ (best.size (), 1, "the two natives can't go together");
+  NS_TEST_ASSERT_MSG_EQ (best[0], 1, "of two single natives the one padding less should win");
+
+  // the size bound only prunes if padding never shrinks as a set grows
+  static const uint32_t lengths[] = { 40, 52, 576, 1000, 1400, 1500 };
+  static const double ratios[] = { 1.0, 0.9, 0.5, 0.1 };
+  uint32_t seed = 1;
+  for (uint32_t round = 0; round < 300; round++)
+    {
+      seed = seed * 1103515245 + 12345;
+      uint32_t count = 1 + (seed >> 16) % 8;
+      double ratio = ratios[(seed >> 8) % 4];
+      search.SetMaxPaddingRatio (ratio);
+      seed = seed * 1103515245 + 12345;
+      set = MakeCodingSet (lengths[(seed >> 16) % 6], (seed >> 4) & 0x1fe);
+      options.clear ();
+      for (uint32_t i = 0; i < count; i++)
+        {
+          seed = seed * 1103515245 + 12345;
+          uint32_t id = 1 + (seed >> 24) % count;
+          options.push_back (MakeCodingOption (id, lengths[(seed >> 16) % 6], ((seed >> 4) & 0x1ff) | 0x1));
+        }
+      int64_t bestPadding = -1;
+      uint32_t bestSize = 0;
+      for (uint32_t subset = 1; subset < (1u << count); subset++)
+        {
+          std::vector<uint32_t> members;
+          for (uint32_t i = 0; i < count; i++)
+            {
+              if (subset & (1u << i))
+                {
+                  members.push_back (i);
+                }
+            }
+          int64_t padding = CodingSetPadding (set, options, members, ratio);
+          if (padding >= 0 && (members.size () > bestSize || (members.size () == bestSize && padding < bestPadding)))
+            {
+              bestSize = members.size ();
+              bestPadding = padding;
+            }
+        }
+      budget = 1 << 16;
+      search.Search (options, set, best, budget);
+      NS_TEST_ASSERT_MSG_EQ (best.size (), bestSize, "search missed the largest set");
+      if (bestSize)
+        {
+          NS_TEST_ASSERT_MSG_EQ (CodingSetPadding (set, options, best, ratio), bestPadding, "search missed the set padding least");
+        }
+    }
+}
+
+// The queue keeps FIFO order, rejects duplicate pids and erases from the middle,
+// and its lanes skip entries that have left the queue. A lowered limit refuses
+// entries until the queue drains below it.
+class IpcopeQueueTestCase : public TestCase
+{
+public:
+  IpcopeQueueTestCase ();
+  virtual ~IpcopeQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeQueueTestCase::IpcopeQueueTestCase ()
+  : TestCase ("Ipcope queue indexes entries by pid")
+{
+}
+
+IpcopeQueueTestCase::~IpcopeQueueTestCase ()
+{
+}
+
+void
+IpcopeQueueTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  IPCopeQueue queue;
+  queue.SetMaxSize (4);
+  for (uint32_t pid = 1; pid <= 3; pid++)
+    {
+      IPCopeQueueEntry entry (Create<Packet> (pid));
+      entry.SetPacketId (pid);
+      NS_TEST_ASSERT_MSG_EQ (queue.EnqueueBack (entry), true, "enqueue failed");
+    }
+  IPCopeQueueEntry duplicate;
+  duplicate.SetPacketId (2);
+  NS_TEST_ASSERT_MSG_EQ (queue.EnqueueFront (duplicate), false, "duplicate pid accepted");
+  IPCopeQueueHandle handle = queue.BackHandle ();
+  NS_TEST_ASSERT_MSG_EQ (queue.Get (handle)->GetPacketId (), 3, "handle resolves to the wrong entry");
+  NS_TEST_ASSERT_MSG_EQ (queue.Erase (3), true, "erase failed");
+  NS_TEST_ASSERT_MSG_EQ (queue.Get (handle) == 0, true, "handle to an erased entry still resolves");
+  IPCopeQueueEntry again (Create<Packet> (3));
+  again.SetPacketId (3);
+  queue.EnqueueBack (again);
+  NS_TEST_ASSERT_MSG_EQ (queue.Get (handle) == 0, true, "handle resolves to a reused node");
+  NS_TEST_ASSERT_MSG_EQ (queue.Erase (2), true, "erase failed");
+  NS_TEST_ASSERT_MSG_EQ (queue.Erase (2), false, "erased pid still indexed");
+  IPCopeQueueEntry front;
+  front.SetPacketId (4);
+  NS_TEST_ASSERT_MSG_EQ (queue.EnqueueFront (front), true, "enqueue at front failed");
+  NS_TEST_ASSERT_MSG_EQ (queue.Size (), 3, "wrong queue size");
+  NS_TEST_ASSERT_MSG_EQ (queue.Dequeue ().GetPacketId (), 4, "wrong order");
+  NS_TEST_ASSERT_MSG_EQ (queue.Dequeue ().GetPacketId (), 1, "wrong order");
+  NS_TEST_ASSERT_MSG_EQ (queue.Dequeue ().GetPacketId (), 3, "wrong order");
+  NS_TEST_ASSERT_MSG_EQ (queue.Size (), 0, "queue should be empty");
+
+  for (uint32_t pid = 5; pid <= 7; pid++)
+    {
+      IPCopeQueueEntry entry (Create<Packet> (pid));
+      entry.SetPacketId (pid);
+      queue.EnqueueBack (entry);
+      queue.AddToLane (1, queue.BackHandle (), false);
+      if (pid != 6)
+        {
+          queue.AddToLane (0, queue.BackHandle (), false);
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue.LaneFront (2, handle), false, "unused lane not empty");
+  NS_TEST_ASSERT_MSG_EQ (queue.LaneFront (0, handle), true, "lane empty");
+  queue.Take (handle);
+  NS_TEST_ASSERT_MSG_EQ (queue.LaneFront (1, handle), true, "lane empty");
+  NS_TEST_ASSERT_MSG_EQ (queue.Get (handle)->GetPacketId (), 6, "lane kept an entry taken by another lane");
+  queue.PopLane (1);
+  NS_TEST_ASSERT_MSG_EQ (queue.LaneFront (1, handle), true, "lane empty");
+  NS_TEST_ASSERT_MSG_EQ (queue.Get (handle)->GetPacketId (), 7, "wrong lane order");
+  NS_TEST_ASSERT_MSG_EQ (queue.Erase (7), true, "erase failed");
+  NS_TEST_ASSERT_MSG_EQ (queue.LaneFront (0, handle), false, "lane kept an erased entry");
+
+  // a lowered limit keeps what is queued and refuses more until the queue drains below it
+  for (uint32_t pid = 8; queue.Size () < 4; pid++)
+    {
+      IPCopeQueueEntry entry (Create<Packet> (pid));
+      entry.SetPacketId (pid);
+      queue.EnqueueBack (entry);
+    }
+  queue.SetMaxSize (2);
+  IPCopeQueueEntry late (Create<Packet> (20));
+  late.SetPacketId (20);
+  NS_TEST_ASSERT_MSG_EQ (queue.EnqueueBack (late), false, "enqueue past a lowered limit accepted");
+  NS_TEST_ASSERT_MSG_EQ (queue.EnqueueFront (late), false, "enqueue at front past a lowered limit accepted");
+  NS_TEST_ASSERT_MSG_EQ (queue.Size (), 4, "lowering the limit dropped entries");
+  queue.Dequeue ();
+  queue.Dequeue ();
+  NS_TEST_ASSERT_MSG_EQ (queue.EnqueueBack (late), false, "enqueue at the lowered limit accepted");
+  queue.Dequeue ();
+  NS_TEST_ASSERT_MSG_EQ (queue.EnqueueBack (late), true, "enqueue below the lowered limit refused");
+}
+
+// Hello gaps lower the inbound estimate, and what neighbors report is looked up by link.
+// Links and reports of a neighbor gone quiet decay and are eventually dropped.
+class IpcopeLinkEstimatorTestCase : public TestCase
+{
+public:
+  IpcopeLinkEstimatorTestCase ();
+  virtual ~IpcopeLinkEstimatorTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckQuiet (ns3::ipcope::IPCopeLinkEstimator *estimator, Mac48Address a, Mac48Address b);
+  void CheckGone (ns3::ipcope::IPCopeLinkEstimator *estimator, Mac48Address a, Mac48Address b);
+};
+
+IpcopeLinkEstimatorTestCase::IpcopeLinkEstimatorTestCase ()
+  : TestCase ("Ipcope link estimator learns delivery ratios from hellos")
+{
+}
+
+IpcopeLinkEstimatorTestCase::~IpcopeLinkEstimatorTestCase ()
+{
+}
+
+void
+IpcopeLinkEstimatorTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  Mac48Address a ("00:00:00:00:00:01");
+  Mac48Address b ("00:00:00:00:00:02");
+  IPCopeLinkEstimator estimator;
+  estimator.SetWeight (0.5);
+  estimator.HelloReceived (a, 10);
+  estimator.HelloReceived (a, 11);
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetInbound (a), 1.0, 1e-9, "no hello lost yet");
+  estimator.HelloReceived (a, 13);
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetInbound (a), 0.75, 1e-9, "one lost hello should count as a zero sample");
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetInbound (b), 0, "unknown link should have no delivery");
+
+  std::vector<LinkReport> reports = estimator.GetReports ();
+  NS_TEST_ASSERT_MSG_EQ (reports.size (), 1, "one inbound link to report");
+  IPCopeHello hello;
+  hello.SetSequence (7);
+  hello.SetLinkReports (reports);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  IPCopeHello received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetSequence (), 7, "hello sequence number lost");
+  estimator.SetReports (b, received.GetLinkReports ());
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetDelivery (a, b), 0.75, 0.01, "reported link a to b");
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetDelivery (b, a), 0, "nobody reported link b to a");
+
+  estimator.SetHelloPeriod (Seconds (10));
+  Simulator::Schedule (Seconds (25), &IpcopeLinkEstimatorTestCase::CheckQuiet, this, &estimator, a, b);
+  Simulator::Schedule (Seconds (80), &IpcopeLinkEstimatorTestCase::CheckGone, this, &estimator, a, b);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+IpcopeLinkEstimatorTestCase::CheckQuiet (ns3::ipcope::IPCopeLinkEstimator *estimator, Mac48Address a, Mac48Address b)
+{
+  // two hello periods without a word count as two lost hellos
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator->GetInbound (a), 0.1875, 1e-9, "quiet link should decay");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator->GetDelivery (a, b), 0.1875, 0.01, "quiet reporter's report should decay");
+}
+
+void
+IpcopeLinkEstimatorTestCase::CheckGone (ns3::ipcope::IPCopeLinkEstimator *estimator, Mac48Address a, Mac48Address b)
+{
+  estimator->Expire ();
+  NS_TEST_ASSERT_MSG_EQ (estimator->GetReports ().size (), 0, "silent link still reported");
+  NS_TEST_ASSERT_MSG_EQ (estimator->GetInbound (a), 0, "silent link not dropped");
+  NS_TEST_ASSERT_MSG_EQ (estimator->GetDelivery (a, b), 0, "report of a silent neighbor not dropped");
+}
+
+// One ack block covers every recent native on a link, a native is acked
+// only once even if later blocks repeat it, ack round trips set the
+// retransmit timeout, and a link survives its nexthop's new primary mac.
+class IpcopeAckTrackerTestCase : public TestCase
+{
+public:
+  IpcopeAckTrackerTestCase ();
+  virtual ~IpcopeAckTrackerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeAckTrackerTestCase::IpcopeAckTrackerTestCase ()
+  : TestCase ("Ipcope acks name natives by per-link sequence numbers")
+{
+}
+
+IpcopeAckTrackerTestCase::~IpcopeAckTrackerTestCase ()
+{
+}
+
+void
+IpcopeAckTrackerTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  Mac48Address nexthop ("00:00:00:00:00:02");
+  Ipv4Address sender ("10.0.0.1");
+  IPCopeAckTracker senderSide;
+  IPCopeAckTracker nexthopSide;
+  for (uint32_t pid = 100; pid < 105; pid++)
+    {
+      uint16_t seq = senderSide.Assign (nexthop, pid);
+      NS_TEST_ASSERT_MSG_EQ (seq, pid - 100, "sequence numbers should count up per link");
+      if (pid != 102)
+        {
+          nexthopSide.Received (sender, seq);
+        }
+    }
+  std::vector<AckBlock> acks = nexthopSide.TakePending (10);
+  NS_TEST_ASSERT_MSG_EQ (acks.size (), 1, "one block per sender");
+  NS_TEST_ASSERT_MSG_EQ (acks[0].lastAck, 4, "wrong last ack");
+  NS_TEST_ASSERT_MSG_EQ (acks[0].ackMap, 0xd, "lost native should be a hole in the map");
+  NS_TEST_ASSERT_MSG_EQ (nexthopSide.TakePending (10).size (), 0, "nothing new to ack");
+  NS_TEST_ASSERT_MSG_EQ (senderSide.Acked (nexthop, acks[0]).size (), 4, "every delivered native acked");
+
+  nexthopSide.Received (sender, 2);
+  acks = nexthopSide.TakePending (10);
+  std::vector<uint32_t> pids = senderSide.Acked (nexthop, acks[0]);
+  NS_TEST_ASSERT_MSG_EQ (pids.size (), 1, "only the late native is newly acked");
+  NS_TEST_ASSERT_MSG_EQ (pids[0], 102, "wrong native acked");
+
+  NS_TEST_ASSERT_MSG_EQ_TOL (senderSide.GetRto (nexthop).GetSeconds (), 0.025, 1e-9, "initial timeout before any sample");
+  senderSide.RttSample (nexthop, MilliSeconds (10));
+  NS_TEST_ASSERT_MSG_EQ_TOL (senderSide.GetRto (nexthop).GetSeconds (), 0.030, 1e-9, "first sample gives srtt + 4 * srtt / 2");
+  senderSide.RttSample (nexthop, Seconds (10));
+  NS_TEST_ASSERT_MSG_EQ_TOL (senderSide.GetRto (nexthop).GetSeconds (), 1.0, 1e-9, "timeout should be capped");
+
+  Mac48Address primary ("00:00:00:00:00:01");
+  senderSide.Rekey (nexthop, primary);
+  uint16_t seq = senderSide.Assign (primary, 105);
+  NS_TEST_ASSERT_MSG_EQ (seq, 5, "numbering restarted under the new primary mac");
+  nexthopSide.Received (sender, seq);
+  acks = nexthopSide.TakePending (10);
+  pids = senderSide.Acked (primary, acks[0]);
+  NS_TEST_ASSERT_MSG_EQ (pids.size (), 1, "native sent after the rekey not acked");
+  NS_TEST_ASSERT_MSG_EQ_TOL (senderSide.GetRto (primary).GetSeconds (), 1.0, 1e-9, "timeout lost in the rekey");
+}
+
+// Neighbor lookups stay in sync with removal and merging.
+class IpcopeNeighborTestCase : public TestCase
+{
+public:
+  IpcopeNeighborTestCase ();
+  virtual ~IpcopeNeighborTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeNeighborTestCase::IpcopeNeighborTestCase ()
+  : TestCase ("Ipcope neighbors are indexed by mac and ip")
+{
+}
+
+IpcopeNeighborTestCase::~IpcopeNeighborTestCase ()
+{
+}
+
+void
+IpcopeNeighborTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  IPCopeNeighbors neighbors;
+  Ipv4Address ipA ("10.0.0.1"), ipB ("10.0.0.2"), ipC ("10.0.0.3");
+  Mac48Address macA ("00:00:00:00:00:01"), macB ("00:00:00:00:00:02"), macC ("00:00:00:00:00:03");
+  neighbors.SMNeighbors (ipA, macA, 1);
+  neighbors.SMNeighbors (ipB, macB, 1);
+  neighbors.SMNeighbors (ipC, macC, 1);
+  NS_TEST_ASSERT_MSG_EQ (neighbors.Size (), 3, "wrong number of neighbors");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.SearchNeighbor (macB), neighbors.SearchNeighbor (ipB), "mac and ip disagree");
+
+  // the last neighbor moves into the hole
+  neighbors.RemoveNeighbor (ipA);
+  NS_TEST_ASSERT_MSG_EQ (neighbors.SearchNeighbor (macA), -1, "removed neighbor still found by mac");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.SearchNeighbor (ipA), -1, "removed neighbor still found by ip");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.At (neighbors.SearchNeighbor (macC))->HasIP (ipC), true, "moved neighbor not reindexed");
+
+  // ip of one neighbor seen with the mac of another merges them
+  neighbors.SMNeighbors (ipB, macC, 2);
+  NS_TEST_ASSERT_MSG_EQ (neighbors.Size (), 1, "neighbors not merged");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.SearchNeighbor (macC), 0, "merged mac not indexed");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.SearchNeighbor (ipC), -1, "ip replaced on the merged mac still indexed");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.SearchNeighbor (macB), 0, "surviving mac not indexed");
+}
+
+// xxHash32 matches the reference vectors, and packet ids hash the payload.
+class IpcopeHashTestCase : public TestCase
+{
+public:
+  IpcopeHashTestCase ();
+  virtual ~IpcopeHashTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+IpcopeHashTestCase::IpcopeHashTestCase ()
+  : TestCase ("Ipcope packet id hash")
+{
+}
+
+IpcopeHashTestCase::~IpcopeHashTestCase ()
+{
+}
+
+void
+IpcopeHashTestCase::DoRun (void)
+{
+  using namespace ns3::ipcope;
+  const char *text = "Nobody inspects the spammish repetition";
+  NS_TEST_ASSERT_MSG_EQ (XxHash32 ((const uint8_t *)"", 0, 0), 0x02cc5d05, "wrong hash of the empty string");
+  NS_TEST_ASSERT_MSG_EQ (XxHash32 ((const uint8_t *)"abc", 3, 0), 0x32d153ff, "wrong hash of a short input");
+  NS_TEST_ASSERT_MSG_EQ (XxHash32 ((const uint8_t *)text, strlen (text), 0), 0xe2293b2f, "wrong hash of a long input");
+
+  Ptr<Packet> packet = Create<Packet> ((const uint8_t *)text, strlen (text));
+  Ipv4Header ipHeader;
+  ipHeader.SetPayloadSize (packet->GetSize ());
+  packet->AddHeader (ipHeader);
+  uint32_t pid = Hash (packet);
+  NS_TEST_ASSERT_MSG_EQ (pid, XxHash32 ((const uint8_t *)text, strlen (text), 0), "id should hash the payload only");
+  // a payload of zeros is stored as a zero area, handed over a byte at a time
+  Ptr<Packet> zeros = Create<Packet> (100);
+  zeros->AddHeader (ipHeader);
+  uint8_t none[100];
+  memset (none, 0, sizeof (none));
+  NS_TEST_ASSERT_MSG_EQ (Hash (zeros), XxHash32 (none, sizeof (none), 0), "wrong id of a zero payload");
+  NS_TEST_ASSERT_MSG_EQ (PacketId (packet), pid, "untagged packet should be hashed");
+  // a tag is trusted as long as the packet keeps its length
+  TagPacketId (packet, pid + 1);
+  TagPacketId (packet, pid + 2);
+  NS_TEST_ASSERT_MSG_EQ (PacketId (packet), pid + 1, "tag should be attached once and trusted");
+  packet->AddPaddingAtEnd (4);
+  NS_TEST_ASSERT_MSG_EQ (PacketId (packet), Hash (packet), "stale tag should be ignored");
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -60,6 +948,17 @@ IpcopeTestSuite::IpcopeTestSuite ()
   : TestSuite ("IPCope", UNIT)
 {
   AddTestCase (new IpcopeTestCase1);
+  AddTestCase (new IpcopeXorTestCase);
+  AddTestCase (new IpcopeHeaderTestCase);
+  AddTestCase (new IpcopePoolTestCase);
+  AddTestCase (new IpcopePacketInfoTestCase);
+  AddTestCase (new IpcopeCodingIndexTestCase);
+  AddTestCase (new IpcopeCodingSearchTestCase);
+  AddTestCase (new IpcopeQueueTestCase);
+  AddTestCase (new IpcopeNeighborTestCase);
+  AddTestCase (new IpcopeLinkEstimatorTestCase);
+  AddTestCase (new IpcopeAckTrackerTestCase);
+  AddTestCase (new IpcopeHashTestCase);
 }
 
 // Do not forget to allocate an instance of this TestSuite